@@ -0,0 +1,102 @@
+#include "amber_base64.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+//
+// times the base64 kernels on a pretrain sized chunk of float32 samples,
+// against the byte at a time push_back loop packed-float bodies were first
+// encoded with.
+//
+
+// the encoder packed-float bodies used before base64_encode_into
+static std::string encode_push_back(const unsigned char *in, uint64_t len) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  uint32_t val = 0;
+  int valb = -6;
+  for (uint64_t i = 0; i < len; i++) {
+    val = (val << 8) + in[i];
+    valb += 8;
+    while (valb >= 0) {
+      out.push_back(alphabet[(val >> valb) & 0x3F]);
+      valb -= 6;
+    }
+  }
+  if (valb > -6) {
+    out.push_back(alphabet[((val << 8) >> (valb + 8)) & 0x3F]);
+  }
+  while (out.size() % 4) {
+    out.push_back('=');
+  }
+  return out;
+}
+
+// best of rounds runs of f, in seconds
+template <typename F> static double best_of(int rounds, F &&f) {
+  double best = 1e9;
+  for (int i = 0; i < rounds; i++) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    double t = std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+    best = t < best ? t : best;
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  size_t samples = 1000000;
+  int rounds = 20;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--samples=", 0) == 0) {
+      samples = std::stoul(arg.substr(10));
+    } else if (arg.rfind("--rounds=", 0) == 0) {
+      rounds = std::stoi(arg.substr(9));
+    } else {
+      std::cerr << "usage: base64-bench [--samples=N] [--rounds=N]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  std::mt19937 rng(5);
+  std::normal_distribution<float> noise(0, 100);
+  std::vector<float> data(samples);
+  for (auto &f : data) {
+    f = noise(rng);
+  }
+  auto in = (const unsigned char *)data.data();
+  size_t len = data.size() * sizeof(float);
+  double mb = len / 1e6;
+  printf("%zu samples, %.1f MB in, %.1f MB out\n", samples, mb,
+         base64_size(len) / 1e6);
+
+  std::string expected;
+  double base = best_of(rounds, [&] { expected = encode_push_back(in, len); });
+  printf("%-10s %8.3f ms %8.1f MB/s\n", "push_back", base * 1e3, mb / base);
+
+  const char *names[] = {"scalar", "ssse3", "avx2"};
+  base64_kernel kernels[] = {base64_kernel::scalar, base64_kernel::ssse3,
+                             base64_kernel::avx2};
+  std::string out(base64_size(len), '\0');
+  for (int k = 0; k < 3; k++) {
+    if (!base64_supported(kernels[k])) {
+      printf("%-10s not supported\n", names[k]);
+      continue;
+    }
+    double t = best_of(rounds, [&] {
+      base64_encode_into(&out[0], in, len, kernels[k]);
+    });
+    printf("%-10s %8.3f ms %8.1f MB/s %6.1fx %s\n", names[k], t * 1e3, mb / t,
+           base / t, out == expected ? "" : "MISMATCH");
+  }
+  return 0;
+}
@@ -0,0 +1,87 @@
+#include "amber_csv.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//
+// compares parse_csv_floats with the stringstream loop pretrain_sensor_xl
+// used to parse its input, on generated pretrain style data: rows of
+// comma separated readings with a mix of magnitudes and precisions.
+//
+
+static std::string generate(size_t values, size_t columns) {
+  std::mt19937 rng(7);
+  std::normal_distribution<float> noise(0, 1);
+  std::string csv;
+  char buf[32];
+  for (size_t i = 0; i < values; i++) {
+    float scale = (float)(1 << (i % columns));
+    int n = snprintf(buf, sizeof(buf), i % 3 == 0 ? "%.6g" : "%.3f",
+                     noise(rng) * scale);
+    csv.append(buf, n);
+    csv.push_back((i + 1) % columns == 0 ? '\n' : ',');
+  }
+  return csv;
+}
+
+// the parse step pretrain_sensor_xl had before parse_csv_floats
+static std::vector<float> parse_stringstream(const std::string &csv) {
+  std::vector<float> values;
+  std::stringstream ss(csv);
+  for (float i; ss >> i;) {
+    values.push_back(i);
+    if (ss.peek() == ',' || isspace(ss.peek()))
+      ss.ignore();
+  }
+  return values;
+}
+
+template <typename F> static double seconds(F &&f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+int main(int argc, char **argv) {
+  size_t values = 20000000;
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--values=", 0) == 0) {
+      values = std::stoul(arg.substr(9));
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      max_threads = std::stoul(arg.substr(10));
+    } else {
+      std::cerr << "usage: csv-bench [--values=N] [--threads=N]" << std::endl;
+      return 1;
+    }
+  }
+
+  auto csv = generate(values, 8);
+  double mb = csv.size() / 1e6;
+  printf("%zu values, %.1f MB\n", values, mb);
+
+  std::vector<float> expected;
+  double base = seconds([&] { expected = parse_stringstream(csv); });
+  printf("%-22s %8.3f s %8.1f MB/s\n", "stringstream", base, mb / base);
+
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    std::vector<float> parsed;
+    bool ok = true;
+    double t = seconds(
+        [&] { ok = parse_csv_floats(csv, parsed, threads); });
+    bool same = ok && parsed == expected;
+    char name[32];
+    snprintf(name, sizeof(name), "parse_csv_floats x%zu", threads);
+    printf("%-22s %8.3f s %8.1f MB/s %6.1fx %s\n", name, t, mb / t, base / t,
+           same ? "" : "MISMATCH");
+  }
+  return 0;
+}
@@ -0,0 +1,155 @@
+#include "amber_sdk.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//
+// compares http/1.1 and http/2 multiplexed streaming against local stand-in
+// servers (see bench/standin_server.py).  each run keeps <window> concurrent
+// stream_sensor requests in flight spread over <sensors> sensor ids and
+// reports the number of connections opened and the latency distribution.
+//
+
+struct bench_result {
+  double seconds;
+  uint64_t connections;
+  uint64_t errors;
+  double p50_ms;
+  double p99_ms;
+};
+
+static bench_result run(const std::string &server, http_version version,
+                        int requests, int sensors, int window) {
+
+  setenv("AMBER_USERNAME", "bench", 0);
+  setenv("AMBER_PASSWORD", "bench", 0);
+  setenv("AMBER_SERVER", server.c_str(), 1);
+  amber_sdk amber("", "");
+  amber.set_http_version(version);
+  amber.set_connection_pool_size(window);
+  amber.set_max_host_connections(version == http_version::http1_1 ? 0 : 4);
+
+  std::mutex lock;
+  std::condition_variable cv;
+  int in_flight = 0;
+  uint64_t errors = 0;
+  std::vector<double> latencies;
+  latencies.reserve(requests);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < requests; i++) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      cv.wait(guard, [&] { return in_flight < window; });
+      in_flight++;
+    }
+    auto sensor_id = "sensor-" + std::to_string(i % sensors);
+    auto sent = std::chrono::steady_clock::now();
+    amber.stream_sensor_async(
+        sensor_id, "1,2,3", false,
+        [&, sent](error_response *err, stream_sensor_response &) {
+          auto elapsed = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - sent)
+                             .count();
+          std::lock_guard<std::mutex> guard(lock);
+          if (err != nullptr) {
+            errors++;
+            delete err;
+          }
+          latencies.push_back(elapsed);
+          in_flight--;
+          cv.notify_all();
+        });
+  }
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    cv.wait(guard, [&] { return in_flight == 0; });
+  }
+  auto seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+    return latencies.empty()
+               ? 0.0
+               : latencies[std::min(latencies.size() - 1,
+                                    size_t(p * latencies.size()))];
+  };
+  return bench_result{seconds, amber.get_connection_stats().connections_opened,
+                      errors, percentile(0.50), percentile(0.99)};
+}
+
+static void report(const char *label, const bench_result &r, int requests) {
+  printf("%-8s %10.0f %12lu %8lu %10.2f %10.2f\n", label, requests / r.seconds,
+         r.connections, r.errors, r.p50_ms, r.p99_ms);
+}
+
+int main(int argc, char *argv[]) {
+
+  std::string h1_server;
+  std::string h2_server;
+  int requests = 5000;
+  int sensors = 1000;
+  int window = 100;
+
+#define OPT_H1 "h1="
+#define OPT_H2 "h2="
+#define OPT_REQUESTS "requests="
+#define OPT_SENSORS "sensors="
+#define OPT_WINDOW "window="
+
+  for (int arg = 1; arg < argc; arg++) {
+    std::string str(argv[arg]);
+    while (str.find('-') == 0) {
+      str.erase(0, 1);
+    }
+
+    if (strncasecmp(OPT_H1, str.c_str(), strlen(OPT_H1)) == 0) {
+      h1_server = str.substr(strlen(OPT_H1));
+    } else if (strncasecmp(OPT_H2, str.c_str(), strlen(OPT_H2)) == 0) {
+      h2_server = str.substr(strlen(OPT_H2));
+    } else if (strncasecmp(OPT_REQUESTS, str.c_str(), strlen(OPT_REQUESTS)) ==
+               0) {
+      requests = std::stoi(str.substr(strlen(OPT_REQUESTS)));
+    } else if (strncasecmp(OPT_SENSORS, str.c_str(), strlen(OPT_SENSORS)) ==
+               0) {
+      sensors = std::stoi(str.substr(strlen(OPT_SENSORS)));
+    } else if (strncasecmp(OPT_WINDOW, str.c_str(), strlen(OPT_WINDOW)) == 0) {
+      window = std::stoi(str.substr(strlen(OPT_WINDOW)));
+    } else {
+      std::cout << "usage: " << argv[0] << " [--" << OPT_H1 << "<url>] [--"
+                << OPT_H2 << "<url>] [--" << OPT_REQUESTS << "<n>] [--"
+                << OPT_SENSORS << "<n>] [--" << OPT_WINDOW << "<n>]\n";
+      exit(1);
+    }
+  }
+  if (h1_server.empty() && h2_server.empty()) {
+    h1_server = "http://127.0.0.1:8080/v1";
+  }
+
+  printf("%d requests, %d sensors, %d in flight\n\n", requests, sensors,
+         window);
+  printf("%-8s %10s %12s %8s %10s %10s\n", "mode", "req/s", "connections",
+         "errors", "p50 ms", "p99 ms");
+  try {
+    if (!h1_server.empty()) {
+      report("http1.1",
+             run(h1_server, http_version::http1_1, requests, sensors, window),
+             requests);
+    }
+    if (!h2_server.empty()) {
+      auto version = h2_server.find("https://") == 0
+                         ? http_version::http2
+                         : http_version::http2_prior_knowledge;
+      report("http2", run(h2_server, version, requests, sensors, window),
+             requests);
+    }
+  } catch (amber_except &e) {
+    std::cout << e.what() << "\n";
+    exit(1);
+  }
+}
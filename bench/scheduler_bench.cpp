@@ -0,0 +1,125 @@
+#include "amber_scheduler.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//
+// measures how stream_scheduler throughput scales with its worker count
+// against a local stand-in server (see bench/standin_server.py, best run with
+// a delay so that requests spend their time waiting on the network).  a share
+// of the batches goes to a few hot sensors, leaving the shards unevenly
+// loaded so that workers have to steal.
+//
+
+struct bench_result {
+  double seconds;
+  scheduler_stats stats;
+  uint64_t connections;
+};
+
+static bench_result run(const std::string &server, size_t workers, int batches,
+                        int sensors, int hot_percent) {
+
+  setenv("AMBER_USERNAME", "bench", 0);
+  setenv("AMBER_PASSWORD", "bench", 0);
+  setenv("AMBER_SERVER", server.c_str(), 1);
+  amber_sdk amber("", "");
+  amber.set_connection_pool_size(workers);
+
+  // warm up the token so that every run starts authenticated
+  get_version_response version;
+  delete amber.get_version(version);
+
+  scheduler_options options;
+  options.workers = workers;
+  options.save_image = false;
+  std::vector<float> data(100, 1.5f);
+  int hot = std::max(1, sensors / 100);
+
+  auto start = std::chrono::steady_clock::now();
+  scheduler_stats stats{};
+  {
+    stream_scheduler scheduler(amber, options, nullptr);
+    for (int i = 0; i < batches; i++) {
+      int sensor = (i % 100) < hot_percent ? i % hot : i % sensors;
+      scheduler.enqueue("sensor-" + std::to_string(sensor), data);
+    }
+    scheduler.drain();
+    stats = scheduler.get_stats();
+  }
+  auto seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  return bench_result{seconds, stats,
+                      amber.get_connection_stats().connections_opened};
+}
+
+int main(int argc, char *argv[]) {
+
+  std::string server = "http://127.0.0.1:8080/v1";
+  size_t max_workers = std::max(1u, std::thread::hardware_concurrency());
+  int batches = 5000;
+  int sensors = 1000;
+  int hot_percent = 50;
+
+#define OPT_SERVER "server="
+#define OPT_WORKERS "workers="
+#define OPT_BATCHES "batches="
+#define OPT_SENSORS "sensors="
+#define OPT_HOT "hot="
+
+  for (int arg = 1; arg < argc; arg++) {
+    std::string str(argv[arg]);
+    while (str.find('-') == 0) {
+      str.erase(0, 1);
+    }
+
+    if (strncasecmp(OPT_SERVER, str.c_str(), strlen(OPT_SERVER)) == 0) {
+      server = str.substr(strlen(OPT_SERVER));
+    } else if (strncasecmp(OPT_WORKERS, str.c_str(), strlen(OPT_WORKERS)) ==
+               0) {
+      max_workers = std::stoul(str.substr(strlen(OPT_WORKERS)));
+    } else if (strncasecmp(OPT_BATCHES, str.c_str(), strlen(OPT_BATCHES)) ==
+               0) {
+      batches = std::stoi(str.substr(strlen(OPT_BATCHES)));
+    } else if (strncasecmp(OPT_SENSORS, str.c_str(), strlen(OPT_SENSORS)) ==
+               0) {
+      sensors = std::stoi(str.substr(strlen(OPT_SENSORS)));
+    } else if (strncasecmp(OPT_HOT, str.c_str(), strlen(OPT_HOT)) == 0) {
+      hot_percent = std::stoi(str.substr(strlen(OPT_HOT)));
+    } else {
+      std::cout << "usage: " << argv[0] << " [--" << OPT_SERVER << "<url>] [--"
+                << OPT_WORKERS << "<n>] [--" << OPT_BATCHES << "<n>] [--"
+                << OPT_SENSORS << "<n>] [--" << OPT_HOT << "<percent>]\n";
+      exit(1);
+    }
+  }
+
+  printf("%d batches, %d sensors, %d%% to the hottest 1%%\n\n", batches,
+         sensors, hot_percent);
+  printf("%8s %10s %8s %8s %12s %8s\n", "workers", "batch/s", "speedup",
+         "steals", "connections", "errors");
+  try {
+    std::vector<size_t> counts;
+    for (size_t workers = 1; workers < max_workers; workers *= 2) {
+      counts.push_back(workers);
+    }
+    counts.push_back(max_workers);
+
+    double base = 0;
+    for (auto workers : counts) {
+      auto r = run(server, workers, batches, sensors, hot_percent);
+      double rate = batches / r.seconds;
+      if (workers == 1) {
+        base = rate;
+      }
+      printf("%8zu %10.0f %8.2f %8lu %12lu %8lu\n", workers, rate, rate / base,
+             r.stats.steals, r.connections, r.stats.errors);
+    }
+  } catch (amber_except &e) {
+    std::cout << e.what() << "\n";
+    exit(1);
+  }
+}
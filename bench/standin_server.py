@@ -0,0 +1,77 @@
+import gzip
+import os
+import sys
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+#
+# http/1.1 keep-alive stand-in for the amber server used by the benchmarks.
+#
+# every request, whatever its method, is answered with the file found at the
+# request path below the docroot (bench/standin by default).  an optional
+# delay in milliseconds simulates server processing time.  bodies over 1 KB
+# are gzipped for clients that accept it.
+#
+#   python3 bench/standin_server.py <port> [delay-ms] [docroot]
+#
+# for http/2 the same docroot can be served with nghttpd:
+#
+#   nghttpd --no-tls -d bench/standin <port>
+#
+
+DOCROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'standin')
+DELAY = 0.0
+
+
+class StandinHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, format, *args):
+        pass
+
+    def respond(self):
+        length = int(self.headers.get('Content-Length', 0))
+        if length > 0:
+            self.rfile.read(length)
+        if DELAY > 0:
+            time.sleep(DELAY)
+
+        path = os.path.normpath(self.path.split('?')[0]).lstrip('/')
+        file_name = os.path.join(DOCROOT, path)
+        code = 200
+        if os.path.isfile(file_name):
+            with open(file_name, 'rb') as f:
+                body = f.read()
+        else:
+            code = 404
+            body = b'{"code": 404, "message": "not found"}'
+
+        self.send_response(code)
+        self.send_header('Content-Type', 'application/json')
+        if len(body) > 1024 and 'gzip' in self.headers.get('Accept-Encoding', ''):
+            body = gzip.compress(body, 6)
+            self.send_header('Content-Encoding', 'gzip')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    do_GET = respond
+    do_POST = respond
+    do_PUT = respond
+    do_DELETE = respond
+
+
+class StandinServer(ThreadingHTTPServer):
+    request_queue_size = 4096
+    daemon_threads = True
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('usage: standin_server.py <port> [delay-ms] [docroot]')
+        sys.exit(1)
+    if len(sys.argv) > 2:
+        DELAY = float(sys.argv[2]) / 1000.0
+    if len(sys.argv) > 3:
+        DOCROOT = sys.argv[3]
+    StandinServer(('127.0.0.1', int(sys.argv[1])), StandinHandler).serve_forever()
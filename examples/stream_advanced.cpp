@@ -1,3 +1,4 @@
+#include "amber_batcher.h"
 #include "amber_sdk.h"
 #include <fstream>
 #include <iostream>
@@ -87,48 +88,40 @@ int main(int argc, char *argv[]) {
     err->dump();
   }
 
-  std::ifstream in("data/output_current.csv");
-  std::string line;
-  std::string value;
-  uint16_t sample_count = 0;
-  std::string csv_data;
-  uint16_t batch_size = 10;
-  while (getline(in, line)) {
-    std::stringstream ss(line);
-    while (getline(ss, value, ',')) {
-      value.erase(remove_if(value.begin(), value.end(), isspace), value.end());
-      if (sample_count == 0)
-        csv_data = value;
-      else
-        csv_data = csv_data + "," + value;
-      sample_count++;
-      if (sample_count % batch_size == 0) {
-        // stream data to a sensor
-        stream_sensor_response stream_sensor_response;
-        err = amber->stream_sensor(stream_sensor_response, my_sensor, csv_data,
-                                   save_image);
-        if (!err) {
-          stream_sensor_response.dump();
-        } else {
-          err->dump();
+  // stream the file in batches aligned to the streaming window
+  try {
+    batch_options options;
+    options.max_delay_ms = 500;
+    options.save_image = save_image;
+    stream_batcher batcher(*amber, my_sensor, options,
+                           [](error_response *err, stream_sensor_response &res,
+                              size_t samples) {
+                             if (!err) {
+                               std::cout << samples << " samples\n";
+                               res.dump();
+                             } else {
+                               err->dump();
+                               delete err;
+                             }
+                           });
+
+    std::ifstream in("data/output_current.csv");
+    std::string line;
+    std::string value;
+    while (getline(in, line)) {
+      std::stringstream ss(line);
+      while (getline(ss, value, ',')) {
+        value.erase(remove_if(value.begin(), value.end(), isspace),
+                    value.end());
+        if (!value.empty()) {
+          batcher.push(std::stof(value));
         }
-        csv_data = "";
-        sample_count = 0;
       }
     }
-  }
 
-  // send any remainder
-  if (sample_count > 0) {
-    // stream data to a sensor
-    stream_sensor_response stream_sensor_response;
-    err = amber->stream_sensor(stream_sensor_response, my_sensor, csv_data,
-                               save_image);
-    if (!err) {
-      stream_sensor_response.dump();
-    } else {
-      err->dump();
-    }
+    // leaving the scope sends the remainder
+  } catch (amber_except &e) {
+    std::cout << e.what() << "\n";
   }
 
   // delete a sensor
@@ -0,0 +1,52 @@
+#ifndef AMBER_CPP_SDK_AMBER_ASYNC_H
+#define AMBER_CPP_SDK_AMBER_ASYNC_H
+
+#include <atomic>
+#include <curl/curl.h>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Single threaded event loop driving any number of concurrent transfers
+ * through one curl multi handle. Easy handles are fully configured by the
+ * caller and handed over with submit(); the completion function is invoked on
+ * the engine thread once the transfer finishes or the engine shuts down; an
+ * exception it throws is dropped. Transfers negotiated as http/2 are
+ * multiplexed over shared connections.
+ */
+class request_engine {
+public:
+  typedef std::function<void(CURLcode result)> completion;
+
+  explicit request_engine(long max_host_connections = 0);
+
+  ~request_engine();
+
+  void submit(CURL *curl, completion done);
+
+  size_t in_flight() { return active.load(); }
+
+private:
+  class transfer {
+  public:
+    CURL *curl;
+    completion done;
+    size_t slot; // index in running once added to the multi handle
+  };
+
+  void run();
+
+  void complete(transfer *t, CURLcode result);
+
+  CURLM *multi;
+  std::thread worker;
+  std::mutex queue_lock;
+  std::vector<transfer *> pending;
+  std::vector<transfer *> running;
+  std::atomic<bool> stopping{};
+  std::atomic<size_t> active{};
+};
+
+#endif // AMBER_CPP_SDK_AMBER_ASYNC_H
@@ -0,0 +1,33 @@
+#ifndef AMBER_CPP_SDK_AMBER_BASE64_H
+#define AMBER_CPP_SDK_AMBER_BASE64_H
+
+#include <cstddef>
+
+// instruction sets base64_encode_into can run on
+enum class base64_kernel {
+  scalar, // portable, three bytes at a time
+  ssse3,  // 12 bytes at a time
+  avx2    // 24 bytes at a time
+};
+
+// encoded size of len bytes, padding included
+inline size_t base64_size(size_t len) { return (len + 2) / 3 * 4; }
+
+// true when this cpu can run kernel
+bool base64_supported(base64_kernel kernel);
+
+// fastest kernel this cpu can run, picked once
+base64_kernel base64_best_kernel();
+
+/**
+ * Write the padded base64 encoding of in to out, which must have room for
+ * base64_size(len) characters. No terminating nul is written.
+ * @return characters written
+ */
+size_t base64_encode_into(char *out, const unsigned char *in, size_t len);
+
+// same, with the given kernel, which must be supported
+size_t base64_encode_into(char *out, const unsigned char *in, size_t len,
+                          base64_kernel kernel);
+
+#endif // AMBER_CPP_SDK_AMBER_BASE64_H
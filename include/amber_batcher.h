@@ -0,0 +1,130 @@
+#ifndef AMBER_CPP_SDK_AMBER_BATCHER_H
+#define AMBER_CPP_SDK_AMBER_BATCHER_H
+
+#include "amber_ring.h"
+#include "amber_sdk.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class batch_options {
+public:
+  size_t max_samples{10000};  // largest batch sent in one request
+  size_t max_bytes{1 << 20};  // largest request body, estimated
+  long max_delay_ms{1000};    // longest a sample waits before it is sent
+  long latency_slo_ms{};      // adapt the batch size to this, 0 to keep it
+  size_t alignment{};         // batch multiple, 0 to read it from the config
+  bool save_image{true};
+  ingest_options intake;      // samples pushed but not yet taken into a batch
+};
+
+class batcher_stats {
+public:
+  uint64_t samples;   // samples streamed
+  uint64_t batches;   // requests sent
+  uint64_t errors;    // requests that failed
+  size_t batch_size;  // current target batch size
+  double latency_ms;  // running average of request latency
+  ingest_stats intake;
+};
+
+/**
+ * Collects samples for one sensor and streams them in batches from a
+ * background thread. A batch goes out once max_samples (or max_bytes) worth
+ * of samples is pending, or when the oldest pending sample has waited for
+ * max_delay_ms. Batches are multiples of streamingWindowSize * featureCount
+ * from the sensor's configuration, except for a partial batch sent when the
+ * delay runs out (still a multiple of featureCount) and the remainder sent
+ * on destruction.
+ *
+ * With a latency_slo_ms the batch size grows while requests complete well
+ * within the objective and is halved when one exceeds it, so throughput is
+ * maximized without breaking the objective.
+ *
+ * push never takes a lock: samples go into a lock-free ingest ring (see
+ * ingest_queue) that the batcher's thread drains, and options.intake decides
+ * what happens when it fills up faster than batches go out.
+ *
+ * Results are delivered in order on the batcher's thread; the callback takes
+ * ownership of err. The client must outlive the batcher.
+ */
+class stream_batcher {
+public:
+  typedef std::function<void(error_response *err,
+                             stream_sensor_response &response, size_t samples)>
+      result_callback;
+
+  stream_batcher(amber_sdk &amber, const std::string &sensor_id,
+                 batch_options options, result_callback callback = nullptr);
+
+  // sends whatever is still pending, then stops the thread
+  ~stream_batcher();
+
+  void push(float sample) {
+    this->intake.push(sample);
+    this->wake();
+  }
+
+  void push(const float *samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      this->intake.push(samples[i]);
+      if ((i & 63) == 63) {
+        this->wake();
+      }
+    }
+    this->wake();
+  }
+
+  void push(const std::vector<float> &samples) {
+    push(samples.data(), samples.size());
+  }
+
+  // send everything pending now and wait until it is sent. an incomplete
+  // trailing feature vector stays pending until its remaining samples arrive
+  void flush();
+
+  batcher_stats get_stats();
+
+private:
+  void run();
+
+  // wake the thread once the intake holds as many samples as it waits for
+  void wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->intake.size() >= this->wake_at.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->cv.notify_all();
+    }
+  }
+
+  bool drain_intake();
+
+  size_t take(bool partial, std::vector<float> &batch);
+
+  void adapt(double latency_ms);
+
+  std::unique_ptr<sensor_handle> handle;
+  batch_options options;
+  ingest_queue intake;
+  std::atomic<size_t> wake_at{SIZE_MAX}; // intake size that wakes the thread
+  result_callback callback;
+  size_t feature_count{1};
+  size_t target; // current batch size, a multiple of options.alignment
+
+  std::mutex lock;
+  std::condition_variable cv;
+  std::vector<float> pending; // taken from the intake, owned by the thread
+  std::chrono::steady_clock::time_point oldest; // arrival of pending[0]
+  bool flush_requested{};
+  bool stopping{};
+  batcher_stats stats{};
+  std::thread worker;
+};
+
+#endif // AMBER_CPP_SDK_AMBER_BATCHER_H
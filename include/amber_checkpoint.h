@@ -0,0 +1,72 @@
+#ifndef AMBER_CPP_SDK_AMBER_CHECKPOINT_H
+#define AMBER_CPP_SDK_AMBER_CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// where one chunk of an xl pretrain sits in its input, in bytes of a file or
+// samples of parsed csv data
+class chunk_extent {
+public:
+  uint64_t begin;   // start of the chunk
+  uint64_t end;     // start of the next chunk
+  uint64_t samples; // samples in the chunk
+};
+
+/**
+ * Progress of an xl pretrain upload: the transaction the server opened, the
+ * extents of the chunks encoded so far and which chunks the server accepted.
+ * Saved after every accepted chunk, it lets an upload that was cut short
+ * carry on with the chunks still missing instead of starting over.
+ */
+class pretrain_checkpoint {
+public:
+  std::string sensor_id;
+  std::string transaction;  // ambertransaction, set once chunk 1 is accepted
+  uint64_t input_size{};    // bytes of pretrain input
+  uint64_t total_samples{};
+  std::vector<chunk_extent> chunks; // extents of chunks encoded so far
+  std::vector<bool> acked;          // per chunk, true once accepted
+
+  // start over for a new upload
+  void reset(const std::string &sensor_id, uint64_t input_size,
+             uint64_t total_samples);
+
+  // true if this is the progress of an upload of the same input
+  bool matches(const std::string &sensor_id, uint64_t input_size,
+               uint64_t total_samples) const;
+
+  // append the extent of the next chunk, not accepted yet
+  void add_chunk(const chunk_extent &extent);
+
+  // samples in the chunks encoded so far
+  uint64_t covered_samples() const;
+
+  // chunks accepted so far
+  size_t acked_count() const;
+
+  /**
+   * Load the checkpoint saved at path.
+   * @return false if there is none or it cannot be read, error() is then
+   * empty or says why
+   */
+  bool load(const std::string &path);
+
+  /**
+   * Save to path, through a temporary file renamed over it so that a crash
+   * never leaves a partial checkpoint behind.
+   * @return false if it cannot be written, see error()
+   */
+  bool save(const std::string &path);
+
+  // delete the checkpoint at path, if any
+  static void remove(const std::string &path);
+
+  const std::string &error() const { return message; }
+
+private:
+  std::string message;
+};
+
+#endif // AMBER_CPP_SDK_AMBER_CHECKPOINT_H
@@ -0,0 +1,90 @@
+#ifndef AMBER_CPP_SDK_AMBER_CHUNKING_H
+#define AMBER_CPP_SDK_AMBER_CHUNKING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// how the samples of an xl pretrain are split into chunks
+class pretrain_chunk_options {
+public:
+  bool adaptive{false}; // size chunks from the measured upload rate
+  size_t initial_samples{1000000}; // every chunk if fixed, the first ones if
+                                   // adaptive
+  size_t min_samples{50000};   // smallest adaptive chunk
+  size_t max_samples{4000000}; // largest adaptive chunk the server accepts
+  double target_seconds{10};   // time an adaptive chunk should take to send
+};
+
+class pretrain_chunk_stats {
+public:
+  uint64_t chunks;    // chunks sent
+  uint64_t samples;   // samples in them
+  size_t smallest;    // fewest samples picked for a chunk
+  size_t largest;     // most samples picked for a chunk
+  double throughput;  // estimated upload rate of the link in bytes per
+                      // second, shared by the chunks in flight, 0 if unknown
+  double overhead_ms; // estimated fixed cost of a chunk: round trip and
+                      // server time
+  std::vector<size_t> sizes; // samples picked for each chunk of the upload
+                             // started last, in order
+};
+
+/**
+ * Picks the size of each chunk of an xl pretrain. Adaptive sizing fits the
+ * time of recent chunks as a fixed overhead plus bytes over upload rate, then
+ * picks the chunk that should take target_seconds: small enough on a slow
+ * link to finish well inside proxy timeouts, large enough on a fast one that
+ * round trips are a small share of the time. Chunks sent at once share the
+ * link, so a chunk's bytes are weighed by the chunks in flight with it and
+ * the rate fitted is that of the link, split between the chunks in flight
+ * when sizing them. Chunks grow at most twofold from one to the next and stay
+ * within the configured bounds. Estimates carry over from one upload to the
+ * next. Thread safe.
+ */
+class chunk_planner {
+public:
+  void set_options(const pretrain_chunk_options &options);
+
+  pretrain_chunk_options get_options();
+
+  // start the sizes of a new upload sending in_flight chunks at once
+  void begin_upload(size_t in_flight = 1);
+
+  // samples for the next chunk
+  size_t next_size();
+
+  // samples next_size would pick now, without taking them
+  size_t peek_size();
+
+  // record a chunk of samples sent as bytes that took seconds, with shared
+  // chunks in flight at once, itself included
+  void record(size_t samples, size_t bytes, double seconds, size_t shared = 1);
+
+  pretrain_chunk_stats get_stats();
+
+private:
+  class sample {
+  public:
+    double bytes; // as if sent alone: bytes times the chunks sharing the link
+    double seconds;
+  };
+
+  void estimate();
+
+  size_t pick();
+
+  std::mutex lock;
+  pretrain_chunk_options options;
+  std::vector<sample> recent; // last chunks sent, oldest overwritten first
+  size_t next_slot{};
+  double bytes_per_sample{}; // as sent, after compression
+  double overhead{};         // seconds per chunk whatever its size
+  double rate{};             // bytes per second, 0 until a chunk is sent
+  size_t in_flight{1};       // chunks of the current upload sent at once
+  size_t last_size{};
+  pretrain_chunk_stats stats{};
+};
+
+#endif // AMBER_CPP_SDK_AMBER_CHUNKING_H
@@ -0,0 +1,78 @@
+#ifndef AMBER_CPP_SDK_AMBER_COMPRESS_H
+#define AMBER_CPP_SDK_AMBER_COMPRESS_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// encoding applied to request bodies
+enum class compression_codec {
+  none, // bodies are sent as they are
+  gzip  // Content-Encoding: gzip
+};
+
+// compression levels follow zlib: 1 is fastest, 9 gives the smallest bodies.
+// compression_level_auto picks the level from measured ratio and cpu time.
+const int compression_level_default = 6;
+const int compression_level_auto = -1;
+
+class compression_stats {
+public:
+  uint64_t bodies;     // bodies at or above the threshold
+  uint64_t compressed; // bodies sent compressed
+  uint64_t bytes_in;   // size of the bodies before compression
+  uint64_t bytes_out;  // size of the bodies as sent
+  int level;           // level currently applied, 0 when sending as is
+};
+
+/**
+ * Request body compressor. Deflate state is kept per thread and reset between
+ * bodies rather than allocated for each one. With compression_level_auto the
+ * compressor keeps running averages of the ratio and the cpu time per byte of
+ * each candidate level, and of the upload rate of compressed transfers, and
+ * picks the level (or no compression) that minimizes cpu time plus time on
+ * the wire. Other levels are sampled now and then so the averages follow the
+ * data.
+ */
+class body_compressor {
+public:
+  void configure(compression_codec codec, int level, size_t threshold);
+
+  /**
+   * Compress body in place when configured and worthwhile.
+   * @return the content encoding to announce, or nullptr if sent as is
+   */
+  const char *compress(std::string &body);
+
+  // feed back the size and upload rate of a transfer
+  void record_upload(uint64_t bytes, double bytes_per_sec);
+
+  compression_stats get_stats();
+
+private:
+  static const int candidate_count = 3;
+
+  int choose_level();
+
+  void record(int level, size_t in, size_t out, double seconds);
+
+  std::mutex lock;
+  compression_codec codec{compression_codec::gzip};
+  int level{compression_level_default};
+  size_t threshold{10000};
+
+  // running averages for compression_level_auto
+  struct {
+    int level;
+    double ratio;         // compressed size / original size
+    double ns_per_byte;   // cpu time per original byte
+    uint64_t samples;
+  } candidates[candidate_count]{{1, 1, 0, 0}, {6, 1, 0, 0}, {9, 1, 0, 0}};
+  double upload_ns_per_byte{100}; // about 10 MB/s until measured
+  uint64_t decisions{};
+  int last_level{};
+
+  compression_stats stats{};
+};
+
+#endif // AMBER_CPP_SDK_AMBER_COMPRESS_H
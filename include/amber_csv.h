@@ -0,0 +1,47 @@
+#ifndef AMBER_CPP_SDK_AMBER_CSV_H
+#define AMBER_CPP_SDK_AMBER_CSV_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+inline bool is_csv_separator(char c) {
+  return c == ',' || c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/**
+ * Parse one number from [p, end), independent of the current locale.
+ * @return end of the number, nullptr if [p, end) does not start with one
+ */
+const char *parse_float(const char *p, const char *end, float &value);
+
+// number of comma or whitespace separated values in data
+size_t count_csv_values(const char *data, size_t size);
+
+/**
+ * Parse up to max values from [p, end) into out, advancing p past them, so
+ * that a large input can be parsed a chunk at a time.
+ * @param count: set to the number of values parsed
+ * @return false if a value is not a number, p is then left at its start
+ */
+bool parse_csv_values(const char *&p, const char *end, float *out, size_t max,
+                      size_t &count);
+
+/**
+ * Parse comma or whitespace separated numbers into out, replacing its
+ * contents. Runs of separators count as one. Large inputs are split at
+ * separators and parsed on several threads, each writing its values straight
+ * to their final place in out.
+ * @param threads: parsing threads, 0 for one per core
+ * @param bad: set to the offset of the first value that is not a number
+ * @return false if a value is not a number, out is then incomplete
+ */
+bool parse_csv_floats(const char *data, size_t size, std::vector<float> &out,
+                      size_t threads = 0, size_t *bad = nullptr);
+
+inline bool parse_csv_floats(const std::string &data, std::vector<float> &out,
+                             size_t threads = 0, size_t *bad = nullptr) {
+  return parse_csv_floats(data.data(), data.size(), out, threads, bad);
+}
+
+#endif // AMBER_CPP_SDK_AMBER_CSV_H
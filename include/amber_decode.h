@@ -0,0 +1,27 @@
+#ifndef AMBER_CPP_SDK_AMBER_DECODE_H
+#define AMBER_CPP_SDK_AMBER_DECODE_H
+
+#include "amber_models.h"
+#include "amber_results.h"
+#include <string>
+
+//
+// single pass response decoders. the response body is fed through a sax
+// handler that stores values straight into the target model, so no json
+// document is built and no document-to-model conversion takes place.
+// each returns false if the body is not valid json.
+//
+
+bool decode_response(const std::string &body,
+                     amber_models::PostStreamResponse &response);
+
+bool decode_response(const std::string &body,
+                     amber_models::PutStreamResponse &response);
+
+bool decode_response(const std::string &body,
+                     amber_models::GetStatusResponse &response);
+
+// appends the result arrays to the store's columns, none if malformed
+bool decode_response(const std::string &body, result_store &store);
+
+#endif // AMBER_CPP_SDK_AMBER_DECODE_H
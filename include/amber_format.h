@@ -0,0 +1,18 @@
+#ifndef AMBER_CPP_SDK_AMBER_FORMAT_H
+#define AMBER_CPP_SDK_AMBER_FORMAT_H
+
+#include <cstddef>
+
+// longest text format_float writes
+const size_t float_text_max = 16;
+
+/**
+ * Write v in the shortest plain decimal form that reads back as the same
+ * float, falling back to %.9g for values too large or too small for that.
+ * Non-finite values are written as nan, inf or -inf.
+ * @param out: at least float_text_max bytes, not terminated
+ * @return number of bytes written
+ */
+size_t format_float(char *out, float v);
+
+#endif // AMBER_CPP_SDK_AMBER_FORMAT_H
@@ -0,0 +1,174 @@
+#ifndef AMBER_CPP_SDK_AMBER_FUSION_H
+#define AMBER_CPP_SDK_AMBER_FUSION_H
+
+#include "amber_format.h"
+#include "amber_sdk.h"
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Precompiled PUT /stream body for a fusion sensor. The json for the whole
+ * feature vector is rendered once from the fusion labels, with a fixed-width
+ * slot held open for every value; an update only writes the new digits into
+ * their slots, so sending a vector allocates nothing and never touches a
+ * json document.
+ *
+ * Slots are padded with spaces, which the server skips like any other json
+ * whitespace. Values that are not finite are sent as null. The body has the
+ * same shape stream_fusion sends for a PutStreamRequest whose features carry
+ * no timestamp.
+ */
+class fusion_encoder {
+public:
+  /**
+   * @param labels: fusion feature labels, in vector order
+   * @param submit_rule: request submit rule, empty for the sensor's default
+   */
+  explicit fusion_encoder(const std::vector<std::string> &labels,
+                          const std::string &submit_rule = "");
+
+  // labels taken from the sensor's fusion configuration
+  explicit fusion_encoder(const std::vector<amber_models::FusionConfig> &config,
+                          const std::string &submit_rule = "");
+
+  size_t size() const { return slots.size(); }
+
+  const std::string &label(size_t index) const { return labels[index]; }
+
+  // position of a label in the vector, throws amber_except if unknown
+  size_t index(const std::string &label) const;
+
+  // write one value into its slot
+  void set(size_t index, float value) {
+    char *slot = &this->text[this->slots[index]];
+    size_t n;
+    if (!std::isfinite(value)) {
+      n = 4;
+      slot[0] = 'n', slot[1] = 'u', slot[2] = 'l', slot[3] = 'l';
+    } else {
+      n = format_float(slot, value);
+    }
+    for (; n < float_text_max; n++) {
+      slot[n] = ' ';
+    }
+  }
+
+  // write values[0..count) into the first count slots
+  void set(const float *values, size_t count);
+
+  void set(const std::vector<float> &values) {
+    set(values.data(), values.size());
+  }
+
+  // request body holding the current values
+  const std::string &body() const { return text; }
+
+private:
+  std::vector<std::string> labels;
+  std::unordered_map<std::string, size_t> positions;
+  std::vector<size_t> slots; // offset of each value slot in text
+  std::string text;
+};
+
+class assembler_options {
+public:
+  bool wait_complete{true}; // hold submissions until every feature has a value
+  size_t max_queued{64};    // vectors waiting to be sent before update blocks
+};
+
+class assembler_stats {
+public:
+  uint64_t updates;    // feature updates merged
+  uint64_t submits;    // vectors sent
+  uint64_t suppressed; // updates that did not trigger a submission
+  uint64_t errors;     // vectors that failed
+  uint64_t queued;     // vectors waiting to be sent
+};
+
+/**
+ * Merges feature updates for a fusion sensor into its current vector and
+ * sends the vector only when the server would submit it to the sensor: when
+ * a feature whose submitRule is not "nosubmit" is updated. Updates to
+ * nosubmit features only change the vector the next submission carries, so
+ * they cost no request at all.
+ *
+ * Updates may come from any thread. Each submission captures the vector as
+ * it stood after the triggering update and is sent in order on the
+ * assembler's thread, through a prepared sensor handle and a fusion_encoder,
+ * with submitRule "submit" so the server does not evaluate the rules again.
+ *
+ * Results are delivered on the assembler's thread; the callback takes
+ * ownership of err.
+ */
+class fusion_assembler {
+public:
+  typedef std::function<void(error_response *err,
+                             stream_fusion_response &response)>
+      result_callback;
+
+  /**
+   * @param config: fusion features, read from the sensor's configuration if
+   * empty
+   */
+  fusion_assembler(amber_sdk &amber, const std::string &sensor_id,
+                   assembler_options options, result_callback callback,
+                   std::vector<amber_models::FusionConfig> config = {});
+
+  // sends every vector already captured, then stops
+  ~fusion_assembler();
+
+  size_t index(const std::string &label) const {
+    return encoder.index(label);
+  }
+
+  /**
+   * Merge a feature update, blocking while max_queued vectors are waiting.
+   * @return true if the update triggered a submission
+   */
+  bool update(size_t index, float value);
+
+  bool update(const std::string &label, float value) {
+    return update(index(label), value);
+  }
+
+  // submit the current vector regardless of the rules
+  void submit();
+
+  // block until every vector captured so far has been sent
+  void drain();
+
+  assembler_stats get_stats();
+
+private:
+  void capture();
+
+  void run();
+
+  std::unique_ptr<sensor_handle> handle;
+  assembler_options options;
+  result_callback callback;
+  fusion_encoder encoder;         // used on the worker thread only
+  std::vector<bool> triggers;     // features whose update submits
+  std::vector<float> current;     // merged vector, under lock
+  std::vector<bool> present;      // features set at least once, under lock
+  size_t missing;                 // features never set, under lock
+
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<std::vector<float>> pending; // captured vectors, oldest first
+  std::vector<std::vector<float>> spare;  // sent vectors kept for reuse
+  bool sending{};
+  bool stopping{};
+  assembler_stats stats{};
+  std::thread worker;
+};
+
+#endif // AMBER_CPP_SDK_AMBER_FUSION_H
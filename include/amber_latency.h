@@ -0,0 +1,38 @@
+#ifndef AMBER_CPP_SDK_AMBER_LATENCY_H
+#define AMBER_CPP_SDK_AMBER_LATENCY_H
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Recent request latencies per endpoint slug. Each slug keeps a sliding
+ * window of its last samples from which percentiles are computed on demand.
+ */
+class latency_tracker {
+public:
+  explicit latency_tracker(size_t window = 256) : window(window) {}
+
+  void record(const std::string &slug, double ms);
+
+  /**
+   * Latency in milliseconds at percentile p (0 to 1) over the recent window.
+   * @return -1 when fewer than min_samples have been recorded for slug
+   */
+  double percentile(const std::string &slug, double p, size_t min_samples = 1);
+
+private:
+  class series {
+  public:
+    std::vector<double> samples;
+    size_t next{}; // slot overwritten once the window is full
+  };
+
+  std::mutex lock;
+  std::unordered_map<std::string, series> slugs;
+  size_t window;
+};
+
+#endif // AMBER_CPP_SDK_AMBER_LATENCY_H
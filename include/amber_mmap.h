@@ -0,0 +1,51 @@
+#ifndef AMBER_CPP_SDK_AMBER_MMAP_H
+#define AMBER_CPP_SDK_AMBER_MMAP_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Read-only memory mapping of a whole file. The pages are read in on demand
+ * as they are touched and can be released once consumed, so streaming through
+ * a large file keeps only a small window of it resident.
+ */
+class mapped_file {
+public:
+  mapped_file() = default;
+
+  ~mapped_file();
+
+  mapped_file(const mapped_file &) = delete;
+
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  /**
+   * Map path, unmapping any file mapped before.
+   * @return false if the file cannot be opened or mapped, see error()
+   */
+  bool open(const std::string &path);
+
+  void close();
+
+  const char *data() const { return begin; }
+
+  size_t size() const { return length; }
+
+  // reason the last open failed
+  const std::string &error() const { return message; }
+
+  // drop the pages of [offset, offset + count) from memory, they are read
+  // again from the file if touched later
+  void release(size_t offset, size_t count);
+
+private:
+  const char *begin{};
+  size_t length{};
+  std::string message;
+#ifdef _WIN32
+  void *file{};
+  void *mapping{};
+#endif
+};
+
+#endif // AMBER_CPP_SDK_AMBER_MMAP_H
@@ -57,4 +57,25 @@ public:
 
 // overrides
 
+namespace amber_models {
+
+class PostAuth2RefreshRequest {
+public:
+  std::string refreshToken;
+
+  friend void to_json(json &j, const PostAuth2RefreshRequest &r) {
+    j["refreshToken"] = r.refreshToken;
+  };
+
+  friend void from_json(const json &j, PostAuth2RefreshRequest &r) {
+    if (j.contains("refreshToken") and !j.at("refreshToken").empty()) {
+      r.refreshToken = j.at("refreshToken").get<std::string>();
+    }
+  };
+
+  AMBER_DUMP()
+};
+
+}; // namespace amber_models
+
 #endif // AMBER_CPP_SDK_AMBER_MODELS_H
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef AMBER_CPP_SDK_AMBER_PIPELINE_H
+#define AMBER_CPP_SDK_AMBER_PIPELINE_H
+
+#include "amber_sdk.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class pipeline_options {
+public:
+  size_t depth{1};          // requests in flight on a shared connection, over
+                            // 1 keeps order on a best-effort basis only
+  size_t max_queued{16};    // batches waiting to be sent before submit blocks
+  int max_retries{3};       // resends of a batch that was refused or unsent
+  long retry_delay_ms{100}; // backoff before the first resend, then doubled
+};
+
+class pipeline_stats {
+public:
+  uint64_t submitted; // batches accepted by submit
+  uint64_t delivered; // results handed to the callback
+  uint64_t retried;   // resends
+  uint64_t failed;    // results delivered with an error
+  size_t window;      // requests currently allowed in flight
+};
+
+/**
+ * Streams batches to one sensor from a queue, delivering the results in
+ * submission order.
+ *
+ * With the default depth of 1 a batch is sent only once the one before it has
+ * completed, so the server receives them strictly in order. A larger depth is
+ * an opt-in for throughput: once a response shows the connection carries
+ * http/2 streams (set_http_version(http2) or http2_prior_knowledge), up to
+ * depth requests are in flight. Streams are issued in order, but neither
+ * http/2 nor curl promise that they stay on one connection or that the
+ * server processes them in the order issued, so order at the sensor is then
+ * best effort. Over http/1.1 one request is sent at a time whatever the
+ * depth.
+ *
+ * A batch is sent again if it is refused with 429 or 503, or fails in
+ * transport before it went out (the host could not be resolved or connected
+ * to). A batch that failed after it was sent, such as a timeout, may already
+ * have been ingested and is reported as failed rather than resent. Sending
+ * pauses until everything in flight has completed, then the failed batches
+ * after the last accepted one are resent in their original order. A failed
+ * batch that a later batch already overtook at the server cannot be resent
+ * without reordering and is reported as failed.
+ *
+ * Batches take the deadline and cancel token in force on the submitting
+ * thread. Results are delivered on the pipeline's thread; the callback takes
+ * ownership of err and must not submit to the same pipeline.
+ */
+class stream_pipeline {
+public:
+  typedef std::function<void(uint64_t seq, error_response *err,
+                             stream_sensor_response &response)>
+      result_callback;
+
+  stream_pipeline(amber_sdk &amber, std::string sensor_id,
+                  pipeline_options options, result_callback callback,
+                  bool save_image = true);
+
+  // waits for every submitted batch to be delivered
+  ~stream_pipeline();
+
+  /**
+   * Queue a batch, blocking while max_queued batches are waiting to be sent.
+   * @return sequence number of the batch, passed back to the callback
+   */
+  uint64_t submit(const std::string &csvdata);
+
+  uint64_t submit(const float *data, size_t count);
+
+  // block until every batch submitted so far has been delivered
+  void drain();
+
+  pipeline_stats get_stats();
+
+private:
+  enum class batch_state { queued, in_flight, retry, done };
+
+  class batch {
+  public:
+    uint64_t seq;
+    std::string body;
+    request_context context; // bounds of the submitting thread
+    batch_state state{batch_state::queued};
+    int attempts{};
+    sdk_response res;
+  };
+
+  uint64_t enqueue(std::string body);
+
+  void run();
+
+  void send(batch *b);
+
+  void complete(batch *b, sdk_response &res);
+
+  void schedule_retries(std::unique_lock<std::mutex> &guard);
+
+  void deliver(batch &b);
+
+  amber_sdk *amber;
+  std::string sensor_id;
+  pipeline_options options;
+  result_callback callback;
+  bool save_image;
+
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<std::unique_ptr<batch>> batches; // undelivered, in order
+  uint64_t next_seq{};
+  size_t in_flight{};
+  size_t awaiting_retry{};
+  bool stopping{};
+  pipeline_stats stats{};
+  std::thread worker;
+};
+
+#endif // AMBER_CPP_SDK_AMBER_PIPELINE_H
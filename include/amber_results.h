@@ -0,0 +1,176 @@
+#ifndef AMBER_CPP_SDK_AMBER_RESULTS_H
+#define AMBER_CPP_SDK_AMBER_RESULTS_H
+
+#include "amber_models.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * Read-only view of consecutive values of one result column, oldest first.
+ */
+template <typename T> class result_span {
+public:
+  result_span() = default;
+
+  result_span(const T *data, size_t size) : ptr(data), count(size) {}
+
+  const T *data() const { return ptr; }
+
+  size_t size() const { return count; }
+
+  bool empty() const { return count == 0; }
+
+  const T *begin() const { return ptr; }
+
+  const T *end() const { return ptr + count; }
+
+  const T &operator[](size_t i) const { return ptr[i]; }
+
+private:
+  const T *ptr{};
+  size_t count{};
+};
+
+/**
+ * Ring of the last capacity values of one column. Every value is written
+ * twice, capacity slots apart, so the most recent values are always
+ * contiguous in memory no matter where the ring has wrapped.
+ */
+template <typename T> class result_column {
+public:
+  explicit result_column(size_t capacity)
+      : cap(capacity), values(new T[2 * capacity]()) {}
+
+  void push(T value) {
+    this->values[this->pos] = value;
+    this->values[this->pos + this->cap] = value;
+    if (++this->pos == this->cap) {
+      this->pos = 0;
+    }
+    this->count++;
+  }
+
+  // the last n values held, all of them by default
+  result_span<T> last(size_t n = SIZE_MAX) const {
+    size_t held = this->count < this->cap ? (size_t)this->count : this->cap;
+    if (n > held) {
+      n = held;
+    }
+    size_t start = (this->pos + this->cap - n) % this->cap;
+    return result_span<T>(&this->values[start], n);
+  }
+
+  uint64_t total() const { return count; }
+
+  void clear() {
+    this->pos = 0;
+    this->count = 0;
+  }
+
+private:
+  size_t cap;
+  size_t pos{};     // slot the next value goes to
+  uint64_t count{}; // values pushed since the last clear
+  std::unique_ptr<T[]> values;
+};
+
+/**
+ * Streaming results of one sensor stored column by column, keeping the last
+ * capacity inferences of each result array. A response body is decoded into
+ * a scratch response, reused so its arrays keep their capacity, and appended
+ * to the columns only once the whole body has decoded, so a malformed body
+ * leaves the store as it was. Nothing is allocated once the scratch arrays
+ * have grown to the largest response.
+ *
+ * Readers get spans over the columns without copying, contiguous so they can
+ * be scanned with vector instructions. A span stays valid for the life of the
+ * store, but appending overwrites the values it shows. The store must be used
+ * by one thread at a time.
+ */
+class result_store {
+public:
+  explicit result_store(size_t capacity);
+
+  // append the results of a PostStreamResponse body, false if malformed
+  bool append(const std::string &body);
+
+  void append(const amber_models::PostStreamResponse &response);
+
+  // scalar fields of the most recent response, its arrays are left empty
+  const amber_models::PostStreamResponse &status() const { return last; }
+
+  // inferences held, at most capacity
+  size_t size() const { return id_column.last().size(); }
+
+  size_t capacity() const { return cap; }
+
+  // inferences appended since construction or the last clear
+  uint64_t total() const { return id_column.total(); }
+
+  void clear();
+
+  result_span<int32_t> id(size_t n = SIZE_MAX) const {
+    return id_column.last(n);
+  }
+
+  result_span<uint16_t> ri(size_t n = SIZE_MAX) const {
+    return ri_column.last(n);
+  }
+
+  result_span<uint16_t> si(size_t n = SIZE_MAX) const {
+    return si_column.last(n);
+  }
+
+  result_span<uint16_t> ad(size_t n = SIZE_MAX) const {
+    return ad_column.last(n);
+  }
+
+  result_span<uint16_t> ah(size_t n = SIZE_MAX) const {
+    return ah_column.last(n);
+  }
+
+  result_span<float> am(size_t n = SIZE_MAX) const {
+    return am_column.last(n);
+  }
+
+  result_span<uint16_t> aw(size_t n = SIZE_MAX) const {
+    return aw_column.last(n);
+  }
+
+  result_span<uint16_t> ni(size_t n = SIZE_MAX) const {
+    return ni_column.last(n);
+  }
+
+  result_span<uint16_t> ns(size_t n = SIZE_MAX) const {
+    return ns_column.last(n);
+  }
+
+  result_span<float> nw(size_t n = SIZE_MAX) const {
+    return nw_column.last(n);
+  }
+
+  result_span<float> om(size_t n = SIZE_MAX) const {
+    return om_column.last(n);
+  }
+
+private:
+  friend bool decode_response(const std::string &body, result_store &store);
+
+  size_t cap;
+  amber_models::PostStreamResponse last{};
+  amber_models::PostStreamResponse pending{}; // body being decoded
+  result_column<int32_t> id_column;
+  result_column<uint16_t> ri_column;
+  result_column<uint16_t> si_column;
+  result_column<uint16_t> ad_column;
+  result_column<uint16_t> ah_column;
+  result_column<float> am_column;
+  result_column<uint16_t> aw_column;
+  result_column<uint16_t> ni_column;
+  result_column<uint16_t> ns_column;
+  result_column<float> nw_column;
+  result_column<float> om_column;
+};
+
+#endif // AMBER_CPP_SDK_AMBER_RESULTS_H
@@ -0,0 +1,211 @@
+#ifndef AMBER_CPP_SDK_AMBER_RING_H
+#define AMBER_CPP_SDK_AMBER_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * Bounded lock-free ring of trivially copyable values. Every slot carries a
+ * sequence number telling whether it is free for the producer or filled for
+ * the consumer of that lap, so neither side ever waits on the other.
+ *
+ * With multi_producer set any number of threads may push; otherwise only
+ * one may. Pops claim their slot with a compare-and-swap, which lets a
+ * producer evict the oldest value while the consumer is popping.
+ */
+template <typename T, bool multi_producer> class ring_buffer {
+public:
+  // capacity is rounded up to a power of two
+  explicit ring_buffer(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    this->mask = size - 1;
+    this->slots.reset(new slot[size]);
+    for (size_t i = 0; i < size; i++) {
+      this->slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool try_push(const T &value) {
+    size_t pos = this->tail.load(std::memory_order_relaxed);
+    slot *s;
+    while (true) {
+      s = &this->slots[pos & this->mask];
+      auto seq = s->seq.load(std::memory_order_acquire);
+      auto dif = (intptr_t)seq - (intptr_t)pos;
+      if (dif < 0) {
+        return false; // full, the slot still holds last lap's value
+      }
+      if (dif > 0) {
+        pos = this->tail.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (!multi_producer) {
+        this->tail.store(pos + 1, std::memory_order_relaxed);
+        break;
+      }
+      if (this->tail.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    s->value = value;
+    s->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T &value) {
+    size_t pos = this->head.load(std::memory_order_relaxed);
+    slot *s;
+    while (true) {
+      s = &this->slots[pos & this->mask];
+      auto seq = s->seq.load(std::memory_order_acquire);
+      auto dif = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (dif < 0) {
+        return false; // empty
+      }
+      if (dif > 0) {
+        pos = this->head.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (this->head.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    value = s->value;
+    s->seq.store(pos + this->mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t pop(T *out, size_t max) {
+    size_t n = 0;
+    while (n < max && this->try_pop(out[n])) {
+      n++;
+    }
+    return n;
+  }
+
+  // values in the ring, exact only while no other thread is using it
+  size_t size() const {
+    auto t = this->tail.load(std::memory_order_acquire);
+    auto h = this->head.load(std::memory_order_acquire);
+    return t > h ? t - h : 0;
+  }
+
+  size_t capacity() const { return this->mask + 1; }
+
+private:
+  class slot {
+  public:
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  // producer and consumer indices on separate cache lines
+  char pad0[64]{};
+  std::atomic<size_t> tail{};
+  char pad1[64]{};
+  std::atomic<size_t> head{};
+  char pad2[64]{};
+  size_t mask;
+  std::unique_ptr<slot[]> slots;
+};
+
+template <typename T> using spsc_ring = ring_buffer<T, false>;
+
+template <typename T> using mpsc_ring = ring_buffer<T, true>;
+
+// what a push does when the ring is full
+enum class overload_policy {
+  block,       // spin until the consumer makes room
+  drop_oldest, // evict the oldest sample
+  drop_newest, // discard the sample being pushed
+  spill        // append to a spill file, read back in order once drained
+};
+
+class ingest_options {
+public:
+  size_t capacity{1 << 16}; // samples held in memory
+  bool multi_producer{true}; // false when a single thread pushes
+  overload_policy policy{overload_policy::block};
+  std::string spill_path; // spill file, an anonymous temporary file if empty
+};
+
+class ingest_stats {
+public:
+  size_t depth;     // samples waiting, in memory and spilled
+  size_t capacity;  // samples the ring holds
+  uint64_t dropped; // samples discarded by drop_oldest or drop_newest
+  uint64_t spilled; // samples written to the spill file
+};
+
+/**
+ * Intake of float samples for one sensor. Producers push without taking a
+ * lock while there is room; what happens once the ring is full depends on
+ * the overload policy. With spill, samples pushed while spilled samples are
+ * waiting go to the file as well, so the consumer still sees them in order.
+ */
+class ingest_queue {
+public:
+  explicit ingest_queue(const ingest_options &options);
+
+  ~ingest_queue();
+
+  ingest_queue(const ingest_queue &) = delete;
+
+  ingest_queue &operator=(const ingest_queue &) = delete;
+
+  // false when the sample was dropped
+  bool push(float sample) {
+    if (!this->spilling.load(std::memory_order_acquire) &&
+        this->try_push(sample)) {
+      return true;
+    }
+    return this->overflow(sample);
+  }
+
+  // pop up to max samples, oldest first. single consumer only.
+  size_t pop(float *out, size_t max);
+
+  // samples in memory, not counting spilled ones
+  size_t size() const {
+    return this->multi ? this->multi->size() : this->single->size();
+  }
+
+  ingest_stats get_stats() const;
+
+private:
+  bool overflow(float sample);
+
+  bool try_push(float sample) {
+    return this->multi ? this->multi->try_push(sample)
+                       : this->single->try_push(sample);
+  }
+
+  bool try_pop(float &sample) {
+    return this->multi ? this->multi->try_pop(sample)
+                       : this->single->try_pop(sample);
+  }
+
+  overload_policy policy;
+  std::unique_ptr<mpsc_ring<float>> multi;
+  std::unique_ptr<spsc_ring<float>> single;
+  std::atomic<uint64_t> dropped{};
+
+  // spill file, read_pos..write_pos hold samples not yet consumed
+  std::atomic<bool> spilling{};
+  mutable std::mutex spill_lock;
+  FILE *spill{};
+  uint64_t read_pos{};
+  uint64_t write_pos{};
+  uint64_t spilled{};
+};
+
+#endif // AMBER_CPP_SDK_AMBER_RING_H
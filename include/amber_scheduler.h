@@ -0,0 +1,122 @@
+#ifndef AMBER_CPP_SDK_AMBER_SCHEDULER_H
+#define AMBER_CPP_SDK_AMBER_SCHEDULER_H
+
+#include "amber_sdk.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class scheduler_options {
+public:
+  size_t workers{};      // i/o threads, 0 for one per core
+  size_t quantum{4};     // batches a worker sends for a sensor before moving on
+  bool save_image{true};
+};
+
+class scheduler_stats {
+public:
+  uint64_t batches; // batches sent
+  uint64_t errors;  // batches that failed
+  uint64_t steals;  // sensors taken from another worker's queue
+  uint64_t queued;  // batches waiting to be sent
+};
+
+/**
+ * Streams for many sensors from a fixed pool of i/o workers. Sensors are
+ * sharded over the workers by id; a sensor with batches waiting sits in its
+ * shard's run queue and is served by one worker at a time, so its batches go
+ * out, and its results come back, in the order they were enqueued. A worker
+ * whose own queue runs dry steals sensors from the back of the others', so a
+ * few busy shards do not leave the rest of the pool idle.
+ *
+ * After quantum batches a sensor goes back to the end of its shard's queue,
+ * keeping a single chatty sensor from starving its neighbours.
+ *
+ * Results are delivered on the worker threads; the callback takes ownership
+ * of err and may enqueue more batches.
+ */
+class stream_scheduler {
+public:
+  typedef std::function<void(const std::string &sensor_id, error_response *err,
+                             stream_sensor_response &response)>
+      result_callback;
+
+  stream_scheduler(amber_sdk &amber, scheduler_options options,
+                   result_callback callback);
+
+  // sends everything still queued, then stops the workers
+  ~stream_scheduler();
+
+  void enqueue(const std::string &sensor_id, std::string csvdata);
+
+  void enqueue(const std::string &sensor_id, const float *data, size_t count);
+
+  void enqueue(const std::string &sensor_id, const std::vector<float> &data) {
+    enqueue(sensor_id, data.data(), data.size());
+  }
+
+  // block until every batch enqueued so far has been sent
+  void drain();
+
+  scheduler_stats get_stats();
+
+  size_t worker_count() const { return shards.size(); }
+
+private:
+  class batch {
+  public:
+    std::string csvdata;
+    std::vector<float> samples;
+    bool packed; // samples holds the data, csvdata is unused
+  };
+
+  class sensor {
+  public:
+    std::string id;
+    std::deque<batch> pending;
+    bool scheduled{}; // in a run queue or being served
+  };
+
+  // sensors homed on one worker and the run queue of those with work
+  class shard {
+  public:
+    std::mutex lock;
+    std::unordered_map<std::string, std::unique_ptr<sensor>> sensors;
+    std::deque<sensor *> runnable;
+  };
+
+  void add(const std::string &sensor_id, batch b);
+
+  void run(size_t index);
+
+  sensor *next(size_t index, size_t &home);
+
+  void serve(size_t home, sensor *s);
+
+  amber_sdk *amber;
+  scheduler_options options;
+  result_callback callback;
+  std::vector<std::unique_ptr<shard>> shards;
+  std::vector<std::thread> workers;
+
+  // idle workers sleep here until any shard has runnable sensors
+  std::mutex idle_lock;
+  std::condition_variable idle_cv;
+  std::condition_variable drained_cv;
+  long runnable{}; // sensors in run queues, under idle_lock
+  bool stopping{};
+
+  std::atomic<uint64_t> queued{};
+  std::atomic<uint64_t> stat_batches{};
+  std::atomic<uint64_t> stat_errors{};
+  std::atomic<uint64_t> stat_steals{};
+};
+
+#endif // AMBER_CPP_SDK_AMBER_SCHEDULER_H
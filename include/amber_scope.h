@@ -0,0 +1,92 @@
+#ifndef AMBER_CPP_SDK_AMBER_SCOPE_H
+#define AMBER_CPP_SDK_AMBER_SCOPE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * Cancellation flag shared between the threads issuing requests and whoever
+ * wants to stop them. Cancelling aborts transfers in flight (libcurl checks
+ * at least once a second) and wakes pretrain polling at once. A token must
+ * outlive the requests it was handed to.
+ */
+class cancel_token {
+public:
+  void cancel();
+
+  bool cancelled() const { return flag.load(); }
+
+  // block until the given time or until cancelled, whichever comes first
+  void wait_until(std::chrono::steady_clock::time_point until);
+
+private:
+  std::atomic<bool> flag{};
+  std::mutex lock;
+  std::condition_variable cv;
+};
+
+// deadline and cancellation in force for the requests of the calling thread
+class request_context {
+public:
+  std::chrono::steady_clock::time_point deadline{
+      std::chrono::steady_clock::time_point::max()};
+  cancel_token *cancel{};
+
+  bool has_deadline() const {
+    return deadline != std::chrono::steady_clock::time_point::max();
+  }
+
+  // milliseconds left before the deadline, at least 1
+  long remaining_ms() const;
+
+  // reason a request must not be sent, nullptr if it may
+  const char *refusal() const;
+
+  // sleep for ms, returning early at the deadline or when cancelled
+  void wait(long ms) const;
+
+  static const request_context &current();
+
+private:
+  friend class request_scope;
+
+  static request_context &mutable_current();
+};
+
+/**
+ * Bound every request the current thread makes while the scope is alive,
+ * on any endpoint, synchronous or asynchronous (asynchronous requests take
+ * the bounds in force when they are issued):
+ *
+ *   cancel_token stop;
+ *   {
+ *     request_scope scope(std::chrono::milliseconds(500), &stop);
+ *     err = amber.get_status(status, sensor_id);
+ *   }
+ *
+ * A request issued after the deadline, or once the token is cancelled, fails
+ * at once with code 0 without touching the network. Waiting for a token
+ * refresh another thread has under way is bounded too. Scopes nest; the inner
+ * scope can only shorten the deadline and inherits the enclosing token when
+ * given none.
+ */
+class request_scope {
+public:
+  explicit request_scope(std::chrono::milliseconds budget,
+                         cancel_token *cancel = nullptr);
+
+  explicit request_scope(cancel_token *cancel);
+
+  ~request_scope();
+
+  request_scope(const request_scope &) = delete;
+
+  request_scope &operator=(const request_scope &) = delete;
+
+private:
+  request_context saved;
+};
+
+#endif // AMBER_CPP_SDK_AMBER_SCOPE_H
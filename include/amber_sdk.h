@@ -1,14 +1,27 @@
 #ifndef AMBER_CPP_SDK_AMBER_SDK_H
 #define AMBER_CPP_SDK_AMBER_SDK_H
 
+#include "amber_async.h"
+#include "amber_chunking.h"
+#include "amber_compress.h"
+#include "amber_latency.h"
+#include "amber_scope.h"
 #include "amber_models.h"
 #include "nlohmann/json.hpp"
+#include <atomic>
+#include <condition_variable>
 #include <cstdarg>
 #include <ctime>
 #include <curl/curl.h>
 #include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 using json = nlohmann::json;
 
@@ -45,6 +58,11 @@ typedef amber_models::Version get_version_response;
 typedef amber_models::GetRootCauseResponse get_root_cause_response;
 typedef amber_models::Error error_response;
 
+class fusion_encoder;
+class result_store;
+class chunk_extent;
+class pretrain_checkpoint;
+
 class sdk_request {
 public:
   std::string operation;
@@ -52,6 +70,8 @@ public:
   std::string body;
   std::string query_params;
   std::map<std::string, std::string> headers;
+  bool raw_result{}; // keep a 200 body undecoded for a model sax decoder
+  const char *content_encoding{}; // body already compressed by the caller
 };
 
 class sdk_response {
@@ -59,8 +79,144 @@ public:
   int code;
   std::map<std::string, std::string> headers;
   json res;
+  std::string body; // set instead of res when the request asked raw_result
+  bool multiplexed{}; // sent as an http/2 stream on a shared connection
+  bool unsent{}; // failed before any of the request went out, safe to resend
+};
+
+// in-flight state of a single request, owned by the caller for synchronous
+// requests and by the completion handler for asynchronous ones
+class sdk_transfer {
+public:
+  sdk_request req;
+  std::string url;
+  CURL *curl{};
+  struct curl_slist *hs{};
+  std::string read_buffer;   // response body
+  std::string header_buffer; // response headers
+  char error_buffer[CURL_ERROR_SIZE]{};
+  body_compressor *compressor{}; // compressor that saw the body
+};
+
+// result delivered by the future returning asynchronous endpoints
+template <typename T> class async_result {
+public:
+  error_response *err;
+  T response;
+};
+
+// http protocol negotiated with the amber server. http/2 streams from the
+// asynchronous endpoints are multiplexed over a few connections per origin.
+enum class http_version {
+  automatic,            // libcurl default negotiation
+  http1_1,              // one request per connection at a time
+  http2,                // http/2 over tls via alpn, falls back to http/1.1
+  http2_prior_knowledge // http/2 without negotiation, for plain http servers
+};
+
+// encoding of the samples sent by the float stream_sensor overloads
+enum class stream_format {
+  automatic,   // packed-float, settling on csv after the first packed 400
+  csv,         // decimal text, always understood
+  packed_float // base64 encoded little endian float32
+};
+
+// layout of the file read by pretrain_sensor_xl_file
+enum class pretrain_file_format {
+  csv,    // comma or whitespace separated decimal text
+  float32 // raw little endian float32 samples
+};
+
+class connection_stats {
+public:
+  uint64_t requests;           // transfers performed
+  uint64_t connections_opened; // transfers that had to open a new connection
+  uint64_t connections_reused; // transfers served on a pooled connection
+};
+
+class hedge_stats {
+public:
+  uint64_t hedged;     // GETs for which a duplicate request was sent
+  uint64_t hedge_wins; // duplicates that answered before the original
+};
+
+// oauth2 token snapshot. never modified once published, a refresh replaces
+// the whole snapshot so readers need no lock.
+class auth_token {
+public:
+  std::string bear_header;
+  std::string refresh_token;
+  std::time_t issued_at;
+  std::time_t expires_at;
+};
+
+class amber_sdk;
+
+/**
+ * Prepared streaming request for one sensor. The url, the static header block
+ * and a bound curl handle are built once so that each call only swaps in the
+ * request body. The url is taken from the client's license when the handle is
+ * created; transport, timeout and compression settings are read from the
+ * client on every call. A handle must be used by one thread at a time and
+ * must not outlive the client that created it.
+ */
+class sensor_handle {
+public:
+  ~sensor_handle();
+
+  const std::string &sensor_id() const { return id; }
+
+  error_response *stream_sensor(stream_sensor_response &response,
+                                const std::string &csvdata,
+                                bool save_image = true);
+
+  error_response *stream_sensor(stream_sensor_response &response,
+                                const float *data, size_t count,
+                                bool save_image = true);
+
+  // append the results to a columnar store instead of a response object
+  error_response *stream_sensor(result_store &store, const std::string &csvdata,
+                                bool save_image = true);
+
+  error_response *stream_sensor(result_store &store, const float *data,
+                                size_t count, bool save_image = true);
+
+  // send the encoder's current vector, see fusion_encoder
+  error_response *stream_fusion(stream_fusion_response &response,
+                                const fusion_encoder &encoder);
+
+private:
+  friend class amber_sdk;
+
+  sensor_handle(amber_sdk *amber, std::string sensor_id);
+
+  bool bind_token(sdk_response &res);
+
+  struct curl_slist *headers(const char *encoding);
+
+  void perform(sdk_response &res, const char *method = nullptr);
+
+  void render_csv(const std::string &csvdata, bool save_image);
+
+  void perform_floats(const float *data, size_t count, bool save_image,
+                      sdk_response &res);
+
+  amber_sdk *amber;
+  std::string id;
+  std::string url;
+  CURL *curl{};
+  struct curl_slist *hs{};         // static headers with the bound token
+  struct curl_slist *hs_encoded{}; // same, announcing hs_encoding
+  std::string hs_encoding;
+  std::shared_ptr<const auth_token> token;
+  std::string body;
+  std::string read_buffer;
+  char error_buffer[CURL_ERROR_SIZE]{};
 };
 
+// a single client may be shared by any number of threads once configured;
+// the setters and the license entry are not synchronized and must be applied
+// before the client is handed to other threads.
 class amber_sdk {
 public:
   explicit amber_sdk() {
@@ -92,6 +248,65 @@ public:
 
   void set_cainfo(std::string cainfo) { ssl.cainfo = std::move(cainfo); }
 
+  void set_connection_pool_size(size_t pool_size);
+
+  void set_keepalive(long idle_secs, long interval_secs) {
+    conn.keepalive_idle = idle_secs;
+    conn.keepalive_interval = interval_secs;
+  }
+
+  void set_http_version(http_version version) { conn.version = version; }
+
+  void set_max_host_connections(long max_connections) {
+    conn.max_host_connections = max_connections;
+  }
+
+  void set_timeouts(long connect_ms, long request_ms) {
+    conn.connect_timeout_ms = connect_ms;
+    conn.request_timeout_ms = request_ms;
+  }
+
+  void set_response_compression(bool enable) {
+    conn.accept_encoding = enable;
+  }
+
+  void set_hedging(bool enable, double percentile = 0.95,
+                   long min_delay_ms = 20);
+
+  double get_latency(const std::string &slug, double percentile = 0.5) {
+    return latency.percentile(slug, percentile);
+  }
+
+  hedge_stats get_hedge_stats();
+
+  connection_stats get_connection_stats();
+
+  void set_compression(compression_codec codec,
+                       int level = compression_level_default,
+                       size_t threshold = 10000);
+
+  void set_pretrain_compression(compression_codec codec,
+                                int level = compression_level_default,
+                                size_t threshold = 10000);
+
+  void set_pretrain_concurrency(size_t chunks_in_flight);
+
+  void set_pretrain_chunking(const pretrain_chunk_options &options);
+
+  compression_stats get_compression_stats() { return compressor.get_stats(); }
+
+  compression_stats get_pretrain_compression_stats() {
+    return pretrain_compressor.get_stats();
+  }
+
+  pretrain_chunk_stats get_pretrain_chunk_stats() {
+    return pretrain_chunks.get_stats();
+  }
+
+  void enable_token_refresh(long lead_secs = 300);
+
+  void disable_token_refresh();
+
   error_response *create_sensor(amber_models::PostSensorResponse &response,
                                 std::string label);
 
@@ -125,10 +340,57 @@ public:
                                 const std::string &sensor_id,
                                 const amber_models::PutStreamRequest &request);
 
+  error_response *stream_fusion(stream_fusion_response &response,
+                                const std::string &sensor_id,
+                                const fusion_encoder &encoder);
+
   error_response *stream_sensor(stream_sensor_response &response,
                                 const std::string &sensor_id,
                                 std::string csvdata, bool save_image = true);
 
+  error_response *stream_sensor(stream_sensor_response &response,
+                                const std::string &sensor_id,
+                                const float *data, size_t count,
+                                bool save_image = true);
+
+  error_response *stream_sensor(stream_sensor_response &response,
+                                const std::string &sensor_id,
+                                const std::vector<float> &data,
+                                bool save_image = true) {
+    return stream_sensor(response, sensor_id, data.data(), data.size(),
+                         save_image);
+  }
+
+  void set_stream_format(stream_format format) { streaming.format = format; }
+
+  std::unique_ptr<sensor_handle> prepare_sensor(const std::string &sensor_id);
+
+  void stream_sensor_async(
+      const std::string &sensor_id, std::string csvdata, bool save_image,
+      std::function<void(error_response *, stream_sensor_response &)> callback);
+
+  std::future<async_result<stream_sensor_response>>
+  stream_sensor_async(const std::string &sensor_id, std::string csvdata,
+                      bool save_image = true);
+
+  void stream_fusion_async(
+      const std::string &sensor_id,
+      const amber_models::PutStreamRequest &request,
+      std::function<void(error_response *, stream_fusion_response &)> callback);
+
+  std::future<async_result<stream_fusion_response>>
+  stream_fusion_async(const std::string &sensor_id,
+                      const amber_models::PutStreamRequest &request);
+
+  void get_status_async(
+      const std::string &sensor_id,
+      std::function<void(error_response *, get_status_response &)> callback);
+
+  std::future<async_result<get_status_response>>
+  get_status_async(const std::string &sensor_id);
+
+  size_t async_in_flight();
+
   error_response *enable_learning(enable_learning_response &response,
                                   const std::string &sensor_id,
                                   uint32_t anomaly_history_window = 10000,
@@ -150,7 +412,15 @@ public:
                                      const std::string &sensor_id,
                                      std::string csvdata,
                                      bool autotuneConfig = true,
-                                     bool blocking = true);
+                                     bool blocking = true,
+                                     const std::string &checkpoint = "");
+
+  error_response *
+  pretrain_sensor_xl_file(pretrain_sensor_response &response,
+                          const std::string &sensor_id, const std::string &path,
+                          pretrain_file_format format = pretrain_file_format::csv,
+                          bool autotuneConfig = true, bool blocking = true,
+                          const std::string &checkpoint = "");
 
   error_response *get_pretrain(get_pretrain_response &response,
                                const std::string &sensor_id);
@@ -174,15 +444,93 @@ public:
   amber_models::license_entry license;
 
 private:
+  friend class sensor_handle;
+  friend class stream_pipeline;
+
   void call_api(sdk_request &req, sdk_response &res, bool is_auth = false);
 
-  bool authenticate(sdk_response &res);
+  // renders the extent.samples samples starting at extent.begin into body,
+  // setting extent.end
+  typedef std::function<error_response *(std::string &body,
+                                         chunk_extent &extent)>
+      chunk_encoder;
+
+  error_response *upload_pretrain(pretrain_sensor_response &response,
+                                  const std::string &sensor_id,
+                                  const chunk_encoder &encode,
+                                  pretrain_checkpoint &progress,
+                                  const std::string &checkpoint);
+
+  error_response *send_pretrain_chunk(pretrain_sensor_response &response,
+                                      const std::string &sensor_id,
+                                      std::string &body, const char *encoding,
+                                      size_t chunk_idx, size_t chunk_max,
+                                      std::string &amber_transaction);
+
+  error_response *await_pretrain(pretrain_sensor_response &response,
+                                 const std::string &sensor_id, bool blocking);
 
-  amber_models::PostAuth2Response auth;
-  uint64_t expires_in{};
-  bool auth_ok{};
-  std::time_t auth_time{};
-  std::string auth_bear_header;
+  void apply_transport_options(CURL *curl);
+
+  void apply_request_context(CURL *curl);
+
+  bool prepare_transfer(sdk_transfer &t, sdk_response &res, bool is_auth);
+
+  void finish_transfer(sdk_transfer &t, CURLcode result, sdk_response &res);
+
+  long hedge_delay(const sdk_request &req);
+
+  void send_float_stream(
+      std::string &body, const float *data, size_t count, bool save_image,
+      const std::function<void(std::string &, sdk_response &)> &send,
+      sdk_response &res);
+
+  void perform_hedged(sdk_transfer &t, long delay_ms, sdk_response &res);
+
+  void render_stream(std::string &body, const float *data, size_t count,
+                     bool save_image);
+
+  void submit_async(sdk_request req, std::function<void(sdk_response &)> done);
+
+  template <typename T>
+  void call_api_async(sdk_request req,
+                      std::function<void(error_response *, T &)> callback);
+
+  request_engine *get_engine();
+
+  void init_transport();
+
+  CURL *acquire_handle();
+
+  void release_handle(CURL *curl);
+
+  void record_connects(CURL *curl);
+
+  body_compressor &compressor_for(const sdk_request &req);
+
+  void record_upload(body_compressor *c, CURL *curl);
+
+  std::shared_ptr<const auth_token> authenticate(sdk_response &res);
+
+  std::shared_ptr<const auth_token> request_token(sdk_response &res,
+                                                  bool use_refresh);
+
+  void refresh_loop();
+
+  // current token, read and replaced with std::atomic_load/atomic_store.
+  // auth_lock makes sure only one thread refreshes an expired token, timed
+  // so that scoped callers stop waiting at their deadline.
+  std::shared_ptr<const auth_token> token;
+  std::timed_mutex auth_lock;
+
+  // background renewal of the token ahead of its expiry
+  struct {
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable cv;
+    bool stop{};
+    long lead_secs{300};
+  } refresher;
   std::string license_id;
   std::string license_file;
 
@@ -192,11 +540,67 @@ private:
     std::string cert;
     std::string cainfo;
   } ssl;
+
+  // connection reuse options
+  struct {
+    size_t pool_size{8};
+    long keepalive_idle{60};
+    long keepalive_interval{30};
+    http_version version{http_version::automatic};
+    long max_host_connections{};
+    bool accept_encoding{true};
+    long connect_timeout_ms{}; // 0 keeps libcurl's default
+    long request_timeout_ms{}; // 0 leaves requests unbounded
+  } conn;
+
+  // pooled easy handles share connections, dns and tls sessions through the
+  // share handle so that consecutive requests skip connection setup
+  CURLSH *share{};
+  std::mutex share_locks[CURL_LOCK_DATA_LAST];
+  std::mutex pool_lock;
+  std::vector<CURL *> idle_handles;
+
+  // event loop for asynchronous requests, started on first use
+  std::unique_ptr<request_engine> engine;
+  std::mutex engine_lock;
+
+  // encoding of float samples and whether the server took packed-float:
+  // 0 not yet known, 1 accepted, -1 csv from now on
+  struct {
+    stream_format format{stream_format::automatic};
+    std::atomic<int> packed{};
+  } streaming;
+
+  // request body compression, pretrain uploads are tuned separately
+  body_compressor compressor;
+  body_compressor pretrain_compressor;
+
+  // chunks of an xl pretrain uploaded at once once the transaction is open
+  struct {
+    size_t in_flight{1};
+  } pretraining;
+
+  // sizes of the chunks of an xl pretrain
+  chunk_planner pretrain_chunks;
+
+  // hedged GETs, a duplicate is sent once the original runs past the given
+  // percentile of the endpoint's recent latency
+  struct {
+    bool enabled{};
+    double percentile{0.95};
+    long min_delay_ms{20};
+  } hedging;
+  latency_tracker latency;
+
+  std::atomic<uint64_t> stat_hedged{};
+  std::atomic<uint64_t> stat_hedge_wins{};
+  std::atomic<uint64_t> stat_requests{};
+  std::atomic<uint64_t> stat_opened{};
+  std::atomic<uint64_t> stat_reused{};
 };
 
 static std::map<std::string, std::string>
 parse_headers(const std::string &header);
-static std::string base64_encode(const unsigned char *in, uint64_t len);
 static std::string join_uint16_vec(std::vector<uint16_t> const &v);
 static std::string
 join_vec_uint16_vec(std::vector<std::vector<uint16_t>> const &v);
@@ -0,0 +1,108 @@
+#include "amber_async.h"
+#include "amber_sdk.h"
+
+request_engine::request_engine(long max_host_connections) {
+  this->multi = curl_multi_init();
+  if (this->multi == nullptr) {
+    throw amber_except("failed to create curl multi handle");
+  }
+
+  // run concurrent http/2 requests as streams on as few connections as
+  // possible, bounded per origin when a limit is given
+  curl_multi_setopt(this->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  if (max_host_connections > 0) {
+    curl_multi_setopt(this->multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+                      max_host_connections);
+  }
+  this->worker = std::thread(&request_engine::run, this);
+}
+
+request_engine::~request_engine() {
+  this->stopping = true;
+  curl_multi_wakeup(this->multi);
+  if (this->worker.joinable()) {
+    this->worker.join();
+  }
+
+  // anything still queued or in progress is reported as aborted
+  for (auto t : this->running) {
+    curl_multi_remove_handle(this->multi, t->curl);
+    this->complete(t, CURLE_ABORTED_BY_CALLBACK);
+  }
+  this->running.clear();
+  for (auto t : this->pending) {
+    this->complete(t, CURLE_ABORTED_BY_CALLBACK);
+  }
+  this->pending.clear();
+  curl_multi_cleanup(this->multi);
+}
+
+/**
+ * Queue a configured easy handle for execution on the engine thread.
+ * @param curl: easy handle with all request options applied
+ * @param done: called exactly once with the transfer result
+ */
+void request_engine::submit(CURL *curl, completion done) {
+  auto t = new transfer{curl, std::move(done), 0};
+  this->active++;
+  {
+    std::lock_guard<std::mutex> guard(this->queue_lock);
+    this->pending.push_back(t);
+  }
+  curl_multi_wakeup(this->multi);
+}
+
+void request_engine::complete(transfer *t, CURLcode result) {
+  // an exception from the completion has nowhere to go on this thread, drop
+  // it rather than end the process and strand the other transfers
+  try {
+    t->done(result);
+  } catch (...) {
+  }
+  delete t;
+  this->active--;
+}
+
+void request_engine::run() {
+  int still_running = 0;
+  while (!this->stopping) {
+
+    // move newly submitted transfers into the multi handle
+    std::vector<transfer *> incoming;
+    {
+      std::lock_guard<std::mutex> guard(this->queue_lock);
+      incoming.swap(this->pending);
+    }
+    for (auto t : incoming) {
+      curl_easy_setopt(t->curl, CURLOPT_PRIVATE, t);
+      curl_multi_add_handle(this->multi, t->curl);
+      t->slot = this->running.size();
+      this->running.push_back(t);
+    }
+
+    curl_multi_perform(this->multi, &still_running);
+
+    // dispatch completed transfers
+    CURLMsg *msg;
+    int msgs_left = 0;
+    while ((msg = curl_multi_info_read(this->multi, &msgs_left)) != nullptr) {
+      if (msg->msg != CURLMSG_DONE) {
+        continue;
+      }
+      transfer *t = nullptr;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&t);
+      auto result = msg->data.result;
+      curl_multi_remove_handle(this->multi, msg->easy_handle);
+
+      // the private pointer locates the transfer, move the last one into
+      // its slot
+      auto last = this->running.back();
+      last->slot = t->slot;
+      this->running[t->slot] = last;
+      this->running.pop_back();
+      this->complete(t, result);
+    }
+
+    curl_multi_poll(this->multi, nullptr, 0, 1000, nullptr);
+  }
+}
@@ -0,0 +1,167 @@
+#include "amber_base64.h"
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AMBER_BASE64_X86 1
+#endif
+
+static const char alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// encode whole groups of three and the padded tail
+static size_t encode_scalar(char *out, const unsigned char *in, size_t len) {
+  char *dst = out;
+  size_t idx = 0;
+  for (; idx + 3 <= len; idx += 3) {
+    uint32_t v = (uint32_t)in[idx] << 16 | (uint32_t)in[idx + 1] << 8 |
+                 in[idx + 2];
+    dst[0] = alphabet[v >> 18];
+    dst[1] = alphabet[(v >> 12) & 0x3F];
+    dst[2] = alphabet[(v >> 6) & 0x3F];
+    dst[3] = alphabet[v & 0x3F];
+    dst += 4;
+  }
+  if (idx < len) {
+    uint32_t v = (uint32_t)in[idx] << 16;
+    if (idx + 1 < len) {
+      v |= (uint32_t)in[idx + 1] << 8;
+    }
+    dst[0] = alphabet[v >> 18];
+    dst[1] = alphabet[(v >> 12) & 0x3F];
+    dst[2] = idx + 1 < len ? alphabet[(v >> 6) & 0x3F] : '=';
+    dst[3] = '=';
+    dst += 4;
+  }
+  return dst - out;
+}
+
+#ifdef AMBER_BASE64_X86
+
+//
+// the vector kernels follow Muła and Lemire, "Faster Base64 Encoding and
+// Decoding using AVX2 Instructions": a byte shuffle spreads every three input
+// bytes over a 32 bit word, two multiplies move the four 6 bit indices into
+// separate bytes, and a 16 entry shuffle table turns each index into its
+// character by adding the offset of the alphabet range it falls in.
+//
+
+__attribute__((target("ssse3"))) static __m128i
+split_ssse3(__m128i in) {
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3,
+                                         4, 1, 2, 0, 1));
+  __m128i hi = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+                               _mm_set1_epi32(0x04000040));
+  __m128i lo = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+                               _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(hi, lo);
+}
+
+__attribute__((target("ssse3"))) static __m128i
+lookup_ssse3(__m128i indices) {
+  // 0..25 map to slot 13, 26..51 to slot 0, 52..63 to slots 1..12
+  __m128i slot = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  slot = _mm_or_si128(slot, _mm_and_si128(upper, _mm_set1_epi8(13)));
+  const __m128i offsets = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  return _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, slot));
+}
+
+__attribute__((target("ssse3"))) static size_t
+encode_ssse3(char *out, const unsigned char *in, size_t len) {
+  char *dst = out;
+  size_t idx = 0;
+  // each step reads 16 bytes and uses 12
+  for (; idx + 16 <= len; idx += 12) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(in + idx));
+    _mm_storeu_si128((__m128i *)dst, lookup_ssse3(split_ssse3(v)));
+    dst += 16;
+  }
+  return dst - out + encode_scalar(dst, in + idx, len - idx);
+}
+
+__attribute__((target("avx2"))) static __m256i split_avx2(__m256i in) {
+  in = _mm256_shuffle_epi8(
+      in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                          10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  __m256i hi =
+      _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+                         _mm256_set1_epi32(0x04000040));
+  __m256i lo =
+      _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+                         _mm256_set1_epi32(0x01000010));
+  return _mm256_or_si256(hi, lo);
+}
+
+__attribute__((target("avx2"))) static __m256i lookup_avx2(__m256i indices) {
+  __m256i slot = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+  __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+  slot = _mm256_or_si256(slot, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+  const __m256i offsets = _mm256_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  return _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, slot));
+}
+
+__attribute__((target("avx2"))) static size_t
+encode_avx2(char *out, const unsigned char *in, size_t len) {
+  char *dst = out;
+  size_t idx = 0;
+  // the shuffle stays within 128 bit lanes, so each lane gets its own 12
+  // bytes. each step reads 28 bytes and uses 24.
+  for (; idx + 28 <= len; idx += 24) {
+    __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(in + idx))),
+        _mm_loadu_si128((const __m128i *)(in + idx + 12)), 1);
+    _mm256_storeu_si256((__m256i *)dst, lookup_avx2(split_avx2(v)));
+    dst += 32;
+  }
+  return dst - out + encode_ssse3(dst, in + idx, len - idx);
+}
+
+#endif // AMBER_BASE64_X86
+
+bool base64_supported(base64_kernel kernel) {
+  switch (kernel) {
+  case base64_kernel::scalar:
+    return true;
+#ifdef AMBER_BASE64_X86
+  case base64_kernel::ssse3:
+    return __builtin_cpu_supports("ssse3");
+  case base64_kernel::avx2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+base64_kernel base64_best_kernel() {
+  static const base64_kernel best =
+      base64_supported(base64_kernel::avx2)    ? base64_kernel::avx2
+      : base64_supported(base64_kernel::ssse3) ? base64_kernel::ssse3
+                                               : base64_kernel::scalar;
+  return best;
+}
+
+size_t base64_encode_into(char *out, const unsigned char *in, size_t len) {
+  return base64_encode_into(out, in, len, base64_best_kernel());
+}
+
+size_t base64_encode_into(char *out, const unsigned char *in, size_t len,
+                          base64_kernel kernel) {
+  switch (kernel) {
+#ifdef AMBER_BASE64_X86
+  case base64_kernel::avx2:
+    return encode_avx2(out, in, len);
+  case base64_kernel::ssse3:
+    return encode_ssse3(out, in, len);
+#endif
+  default:
+    return encode_scalar(out, in, len);
+  }
+}
@@ -0,0 +1,209 @@
+#include "amber_batcher.h"
+#include <algorithm>
+
+// conservative size of one sample in a request body, csv with separator
+static const size_t bytes_per_sample = 11;
+
+stream_batcher::stream_batcher(amber_sdk &amber, const std::string &sensor_id,
+                               batch_options options, result_callback callback)
+    : options(options), intake(options.intake), callback(std::move(callback)) {
+
+  // align batches to whole streaming windows
+  if (this->options.alignment == 0) {
+    get_config_response config;
+    auto err = amber.get_config(config, sensor_id);
+    if (err != nullptr) {
+      auto e = amber_except("failed to read configuration of %s: %s",
+                            sensor_id.c_str(), err->message.c_str());
+      delete err;
+      throw e;
+    }
+    this->feature_count = std::max<size_t>(1, config.featureCount);
+    this->options.alignment =
+        std::max<size_t>(1, config.streamingWindowSize) * this->feature_count;
+  }
+
+  // the largest batch honours both the sample and the byte budget
+  size_t align = this->options.alignment;
+  size_t max = std::min(this->options.max_samples,
+                        this->options.max_bytes / bytes_per_sample);
+  this->options.max_samples = std::max(align, max / align * align);
+  this->target = this->options.latency_slo_ms > 0 ? align
+                                                  : this->options.max_samples;
+
+  this->handle = amber.prepare_sensor(sensor_id);
+  this->stats.batch_size = this->target;
+  this->worker = std::thread(&stream_batcher::run, this);
+}
+
+stream_batcher::~stream_batcher() {
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->stopping = true;
+  }
+  this->cv.notify_all();
+  this->worker.join();
+}
+
+void stream_batcher::flush() {
+  std::unique_lock<std::mutex> guard(this->lock);
+  this->flush_requested = true;
+  this->cv.notify_all();
+  this->cv.wait(guard, [this] { return !this->flush_requested; });
+}
+
+batcher_stats stream_batcher::get_stats() {
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->stats.intake = this->intake.get_stats();
+  return this->stats;
+}
+
+/**
+ * Move what producers pushed into pending, at most about one ring's worth so
+ * that a flood of samples cannot keep the thread here forever. Lock must be
+ * held.
+ * @return true when the intake may still hold samples
+ */
+bool stream_batcher::drain_intake() {
+  float buffer[1024];
+  size_t drained = 0;
+  while (drained < this->options.intake.capacity) {
+    auto n = this->intake.pop(buffer, 1024);
+    if (n == 0) {
+      return false;
+    }
+    if (this->pending.empty()) {
+      this->oldest = std::chrono::steady_clock::now();
+    }
+    this->pending.insert(this->pending.end(), buffer, buffer + n);
+    drained += n;
+  }
+  return true;
+}
+
+/**
+ * Move the next batch from pending into batch. A full batch is the current
+ * target size; a partial one is cut at the last complete feature vector.
+ * Lock must be held.
+ */
+size_t stream_batcher::take(bool partial, std::vector<float> &batch) {
+  size_t n = std::min(this->pending.size(), this->target);
+  if (!partial) {
+    n = n / this->options.alignment * this->options.alignment;
+  } else if (!this->stopping) {
+    n = n / this->feature_count * this->feature_count;
+  }
+  batch.assign(this->pending.begin(), this->pending.begin() + n);
+  this->pending.erase(this->pending.begin(), this->pending.begin() + n);
+  if (!this->pending.empty()) {
+    this->oldest = std::chrono::steady_clock::now();
+  }
+  return n;
+}
+
+void stream_batcher::run() {
+  std::vector<float> batch;
+  std::unique_lock<std::mutex> guard(this->lock);
+  while (true) {
+    bool more = this->drain_intake();
+    auto now = std::chrono::steady_clock::now();
+    auto due = this->oldest + std::chrono::milliseconds(options.max_delay_ms);
+    bool full = this->pending.size() >= this->target;
+
+    // an incomplete feature vector waits for the rest of its samples
+    size_t ready = this->pending.size();
+    if (!this->stopping) {
+      ready = ready / this->feature_count * this->feature_count;
+    }
+    bool send = ready > 0 && (full || now >= due || this->stopping ||
+                              this->flush_requested);
+
+    if (!send) {
+      if (more) {
+        continue;
+      }
+      if (ready == 0 && this->flush_requested) {
+        this->flush_requested = false;
+        this->cv.notify_all();
+      }
+      if (this->stopping) {
+        break;
+      }
+
+      // ask producers to wake the thread once the samples it waits for are
+      // in, then look again in case they arrived before the request did
+      size_t want = ready == 0 ? this->feature_count - this->pending.size()
+                               : this->target - this->pending.size();
+      want = std::max<size_t>(
+          1, std::min(want, this->options.intake.capacity / 2));
+      this->wake_at.store(want, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (this->intake.size() < want) {
+        if (ready == 0) {
+          // bounded as well, a producer stuck on a full intake never wakes us
+          this->cv.wait_for(guard,
+                            std::chrono::milliseconds(options.max_delay_ms));
+        } else {
+          this->cv.wait_until(guard, due);
+        }
+      }
+      this->wake_at.store(SIZE_MAX, std::memory_order_relaxed);
+      continue;
+    }
+    this->take(!full, batch);
+
+    // send without holding the lock so that producers are never blocked
+    guard.unlock();
+    stream_sensor_response response;
+    auto start = std::chrono::steady_clock::now();
+    error_response *err;
+    try {
+      err = this->handle->stream_sensor(response, batch.data(), batch.size(),
+                                        options.save_image);
+    } catch (std::exception &e) {
+      // an exception leaving the sending thread would end the process
+      err = new error_response{0, e.what()};
+    }
+    double latency_ms = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    guard.lock();
+
+    this->stats.batches++;
+    this->stats.samples += batch.size();
+    this->stats.errors += err != nullptr ? 1 : 0;
+    this->stats.latency_ms = this->stats.batches == 1
+                                 ? latency_ms
+                                 : 0.8 * this->stats.latency_ms +
+                                       0.2 * latency_ms;
+    if (err == nullptr && full) {
+      this->adapt(latency_ms);
+    }
+
+    guard.unlock();
+    if (this->callback) {
+      this->callback(err, response, batch.size());
+    } else {
+      delete err;
+    }
+    guard.lock();
+  }
+}
+
+// grow the batch while well within the latency objective, halve it when the
+// objective is missed. lock must be held.
+void stream_batcher::adapt(double latency_ms) {
+  if (this->options.latency_slo_ms <= 0) {
+    return;
+  }
+  size_t align = this->options.alignment;
+  auto slo = (double)this->options.latency_slo_ms;
+  if (latency_ms > slo) {
+    this->target = std::max(align, this->target / 2 / align * align);
+  } else if (latency_ms < 0.8 * slo) {
+    size_t grown = (this->target * 5 / 4 + align - 1) / align * align;
+    this->target = std::min(this->options.max_samples,
+                            std::max(grown, this->target + align));
+  }
+  this->stats.batch_size = this->target;
+}
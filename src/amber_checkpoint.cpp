@@ -0,0 +1,115 @@
+#include "amber_checkpoint.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using json = nlohmann::json;
+
+void pretrain_checkpoint::reset(const std::string &sensor_id,
+                                uint64_t input_size, uint64_t total_samples) {
+  this->sensor_id = sensor_id;
+  this->transaction.clear();
+  this->input_size = input_size;
+  this->total_samples = total_samples;
+  this->chunks.clear();
+  this->acked.clear();
+}
+
+bool pretrain_checkpoint::matches(const std::string &sensor_id,
+                                  uint64_t input_size,
+                                  uint64_t total_samples) const {
+  return this->sensor_id == sensor_id && this->input_size == input_size &&
+         this->total_samples == total_samples;
+}
+
+void pretrain_checkpoint::add_chunk(const chunk_extent &extent) {
+  this->chunks.push_back(extent);
+  this->acked.push_back(false);
+}
+
+uint64_t pretrain_checkpoint::covered_samples() const {
+  uint64_t covered = 0;
+  for (auto &c : this->chunks) {
+    covered += c.samples;
+  }
+  return covered;
+}
+
+size_t pretrain_checkpoint::acked_count() const {
+  return std::count(this->acked.begin(), this->acked.end(), true);
+}
+
+bool pretrain_checkpoint::load(const std::string &path) {
+  this->message.clear();
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  try {
+    json j = json::parse(file);
+    this->sensor_id = j.at("sensorId");
+    this->transaction = j.at("transaction");
+    this->input_size = j.at("inputSize");
+    this->total_samples = j.at("totalSamples");
+    this->chunks.clear();
+    for (auto &c : j.at("chunks")) {
+      this->chunks.push_back(chunk_extent{c.at(0), c.at(1), c.at(2)});
+    }
+    this->acked.assign(this->chunks.size(), false);
+    for (size_t idx : j.at("acked")) {
+      if (idx >= this->chunks.size()) {
+        throw std::out_of_range("chunk " + std::to_string(idx));
+      }
+      this->acked[idx] = true;
+    }
+  } catch (const std::exception &e) {
+    this->message = "unreadable pretrain checkpoint " + path + ": " + e.what();
+    return false;
+  }
+  return true;
+}
+
+bool pretrain_checkpoint::save(const std::string &path) {
+  json chunks = json::array();
+  for (auto &c : this->chunks) {
+    chunks.push_back({c.begin, c.end, c.samples});
+  }
+  json acked = json::array();
+  for (size_t idx = 0; idx < this->acked.size(); idx++) {
+    if (this->acked[idx]) {
+      acked.push_back(idx);
+    }
+  }
+  json j = {{"sensorId", this->sensor_id},
+            {"transaction", this->transaction},
+            {"inputSize", this->input_size},
+            {"totalSamples", this->total_samples},
+            {"chunks", chunks},
+            {"acked", acked}};
+
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream file(tmp, std::ios::trunc);
+    file << j.dump();
+    if (!file.flush()) {
+      this->message = "cannot write pretrain checkpoint " + tmp;
+      return false;
+    }
+  }
+#ifdef _WIN32
+  std::remove(path.c_str()); // rename does not replace on windows
+#endif
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    this->message = "cannot write pretrain checkpoint " + path + ": " +
+                    strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+void pretrain_checkpoint::remove(const std::string &path) {
+  std::remove(path.c_str());
+}
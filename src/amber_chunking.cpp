@@ -0,0 +1,117 @@
+#include "amber_chunking.h"
+#include <algorithm>
+#include <cmath>
+
+// chunks the upload rate is estimated from
+static const size_t window = 8;
+
+void chunk_planner::set_options(const pretrain_chunk_options &options) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->options = options;
+  this->last_size = 0;
+}
+
+pretrain_chunk_options chunk_planner::get_options() {
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->options;
+}
+
+void chunk_planner::begin_upload(size_t in_flight) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->in_flight = std::max<size_t>(1, in_flight);
+  this->stats.sizes.clear();
+}
+
+/**
+ * Fit seconds = overhead + bytes / rate over the recent chunks by least
+ * squares. Once chunks settle on much the same size they no longer separate
+ * the two, the last overhead fitted is then kept and only the rate updated.
+ */
+void chunk_planner::estimate() {
+  size_t n = this->recent.size();
+  double mean_b = 0, mean_t = 0;
+  for (auto &s : this->recent) {
+    mean_b += s.bytes / n;
+    mean_t += s.seconds / n;
+  }
+  double var_b = 0, cov = 0;
+  for (auto &s : this->recent) {
+    var_b += (s.bytes - mean_b) * (s.bytes - mean_b);
+    cov += (s.bytes - mean_b) * (s.seconds - mean_t);
+  }
+  if (n >= 2 && std::sqrt(var_b / n) > 0.1 * mean_b && cov > 0) {
+    double per_byte = cov / var_b;
+    double intercept = mean_t - per_byte * mean_b;
+    if (intercept >= 0) {
+      this->overhead = intercept;
+      this->rate = 1 / per_byte;
+      return;
+    }
+  }
+  double send = mean_t - this->overhead;
+  this->rate = mean_b / (send > 0 ? send : mean_t);
+}
+
+// size of the next chunk, lock held
+size_t chunk_planner::pick() {
+  auto &o = this->options;
+  size_t size = o.initial_samples;
+  if (o.adaptive && this->rate > 0 && this->bytes_per_sample > 0) {
+    // a target the overhead alone uses up leaves nothing to gain from
+    // smaller chunks, so send the largest
+    // every chunk in flight gets its share of the link
+    double send = o.target_seconds - this->overhead;
+    double share = this->rate / this->in_flight;
+    double wanted = send > 0 ? send * share / this->bytes_per_sample
+                             : (double)o.max_samples;
+    if (this->last_size > 0) {
+      wanted = std::min(wanted, 2.0 * this->last_size);
+    }
+    wanted = std::max(wanted, (double)o.min_samples);
+    size = (size_t)std::min(wanted, (double)o.max_samples);
+  }
+  return size;
+}
+
+size_t chunk_planner::next_size() {
+  std::lock_guard<std::mutex> guard(this->lock);
+  size_t size = this->pick();
+  this->last_size = size;
+  this->stats.sizes.push_back(size);
+  this->stats.smallest =
+      this->stats.smallest == 0 ? size : std::min(this->stats.smallest, size);
+  this->stats.largest = std::max(this->stats.largest, size);
+  return size;
+}
+
+void chunk_planner::record(size_t samples, size_t bytes, double seconds,
+                           size_t shared) {
+  if (samples == 0 || seconds <= 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(this->lock);
+  sample s{(double)bytes * std::max<size_t>(1, shared), seconds};
+  if (this->recent.size() < window) {
+    this->recent.push_back(s);
+  } else {
+    this->recent[this->next_slot] = s;
+    this->next_slot = (this->next_slot + 1) % window;
+  }
+  this->bytes_per_sample = (double)bytes / samples;
+  this->estimate();
+  this->stats.chunks++;
+  this->stats.samples += samples;
+}
+
+size_t chunk_planner::peek_size() {
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->pick();
+}
+
+pretrain_chunk_stats chunk_planner::get_stats() {
+  std::lock_guard<std::mutex> guard(this->lock);
+  pretrain_chunk_stats s = this->stats;
+  s.throughput = this->rate;
+  s.overhead_ms = this->overhead * 1000;
+  return s;
+}
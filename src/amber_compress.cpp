@@ -0,0 +1,194 @@
+#include "amber_compress.h"
+#include <chrono>
+#include <cstring>
+#include <zlib.h>
+
+namespace {
+
+// weight of a new sample in the running averages
+const double sample_weight = 0.2;
+
+// with compression_level_auto every explore_interval-th body samples another
+// candidate level instead of the best one
+const uint64_t explore_interval = 16;
+
+// uploads smaller than this say more about latency than about the link
+const uint64_t min_upload_sample = 4096;
+
+// per thread output buffers above this size are released after use
+const size_t max_retained_buffer = 4 << 20;
+
+/**
+ * Gzip deflate stream reused by every body compressed on the owning thread.
+ * deflateReset keeps the allocated window and hash tables.
+ */
+class deflate_context {
+public:
+  deflate_context() {
+    memset(&this->zs, 0, sizeof(this->zs));
+    this->ready = deflateInit2(&this->zs, this->level, Z_DEFLATED, 15 | 16, 8,
+                               Z_DEFAULT_STRATEGY) == Z_OK;
+  }
+
+  ~deflate_context() {
+    if (this->ready) {
+      deflateEnd(&this->zs);
+    }
+  }
+
+  // compress in into out, false on failure
+  bool deflate_into(const std::string &in, std::string &out, int new_level) {
+    if (!this->ready || deflateReset(&this->zs) != Z_OK) {
+      return false;
+    }
+    if (new_level != this->level) {
+      // nothing is buffered right after a reset so the change applies cleanly
+      if (deflateParams(&this->zs, new_level, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+      }
+      this->level = new_level;
+    }
+
+    // size the output once for the worst case and deflate in a single call
+    out.resize(deflateBound(&this->zs, in.size()));
+    this->zs.next_in = (Bytef *)in.data();
+    this->zs.avail_in = (uInt)in.size();
+    this->zs.next_out = (Bytef *)&out[0];
+    this->zs.avail_out = (uInt)out.size();
+    if (deflate(&this->zs, Z_FINISH) != Z_STREAM_END) {
+      return false;
+    }
+    out.resize(this->zs.total_out);
+    return true;
+  }
+
+private:
+  z_stream zs;
+  int level{compression_level_default};
+  bool ready{};
+};
+
+} // namespace
+
+void body_compressor::configure(compression_codec new_codec, int new_level,
+                                size_t new_threshold) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->codec = new_codec;
+  this->level = new_level;
+  this->threshold = new_threshold;
+}
+
+const char *body_compressor::compress(std::string &body) {
+  int use_level;
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->codec == compression_codec::none ||
+        body.size() < this->threshold) {
+      return nullptr;
+    }
+    this->stats.bodies++;
+    this->stats.bytes_in += body.size();
+    use_level = this->choose_level();
+    if (use_level == 0) {
+      this->stats.bytes_out += body.size();
+      this->stats.level = 0;
+      return nullptr;
+    }
+  }
+
+  // the output buffer is swapped with the body, so each thread keeps reusing
+  // the capacity of its previous body
+  static thread_local deflate_context context;
+  static thread_local std::string scratch;
+  auto start = std::chrono::steady_clock::now();
+  bool ok = context.deflate_into(body, scratch, use_level);
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  size_t in = body.size();
+  size_t out = ok ? scratch.size() : in;
+  bool worthwhile = ok && out < in;
+  if (worthwhile) {
+    body.swap(scratch);
+  }
+  if (scratch.capacity() > max_retained_buffer) {
+    std::string().swap(scratch);
+  }
+
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->record(use_level, in, out, seconds);
+  this->stats.level = use_level;
+  if (!worthwhile) {
+    this->stats.bytes_out += in;
+    return nullptr;
+  }
+  this->stats.compressed++;
+  this->stats.bytes_out += out;
+  return "gzip";
+}
+
+void body_compressor::record_upload(uint64_t bytes, double bytes_per_sec) {
+  if (bytes < min_upload_sample || bytes_per_sec <= 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->upload_ns_per_byte +=
+      sample_weight * (1e9 / bytes_per_sec - this->upload_ns_per_byte);
+}
+
+compression_stats body_compressor::get_stats() {
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->stats;
+}
+
+// pick the level for the next body, 0 to send it as is. lock must be held.
+int body_compressor::choose_level() {
+  if (this->level != compression_level_auto) {
+    return this->level;
+  }
+  this->decisions++;
+
+  // every candidate is measured at least once, then sampled periodically
+  for (auto &c : this->candidates) {
+    if (c.samples == 0) {
+      return c.level;
+    }
+  }
+  if (this->decisions % explore_interval == 0) {
+    return this->candidates[(this->decisions / explore_interval) %
+                            candidate_count]
+        .level;
+  }
+
+  // estimated nanoseconds per original byte, sending as is costs wire time only
+  int best = 0;
+  double best_cost = this->upload_ns_per_byte;
+  for (auto &c : this->candidates) {
+    double cost = c.ns_per_byte + c.ratio * this->upload_ns_per_byte;
+    if (cost < best_cost) {
+      best = c.level;
+      best_cost = cost;
+    }
+  }
+  return best;
+}
+
+// update the running averages of a candidate level. lock must be held.
+void body_compressor::record(int used_level, size_t in, size_t out,
+                             double seconds) {
+  for (auto &c : this->candidates) {
+    if (c.level != used_level) {
+      continue;
+    }
+    double ratio = (double)out / (double)in;
+    double ns_per_byte = seconds * 1e9 / (double)in;
+    if (c.samples == 0) {
+      c.ratio = ratio;
+      c.ns_per_byte = ns_per_byte;
+    } else {
+      c.ratio += sample_weight * (ratio - c.ratio);
+      c.ns_per_byte += sample_weight * (ns_per_byte - c.ns_per_byte);
+    }
+    c.samples++;
+  }
+}
@@ -0,0 +1,244 @@
+#include "amber_csv.h"
+#include <algorithm>
+#include <bitset>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <locale>
+#include <sstream>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AMBER_CSV_SSE2 1
+#endif
+
+// smallest share of the input worth a thread of its own
+static const size_t min_piece = 1 << 20;
+
+// parse a number the fast path cannot round exactly
+static const char *parse_float_slow(const char *p, const char *end,
+                                    float &value) {
+  const char *stop = p;
+  while (stop < end && !is_csv_separator(*stop)) {
+    stop++;
+  }
+  std::istringstream ss(std::string(p, stop));
+  ss.imbue(std::locale::classic());
+  float v;
+  if (!(ss >> v) || ss.peek() != std::char_traits<char>::eof()) {
+    return nullptr;
+  }
+  value = v;
+  return stop;
+}
+
+const char *parse_float(const char *p, const char *end, float &value) {
+  static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char *start = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  // up to 19 significant digits fit the mantissa, the rest only scale it
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool truncated = false;
+  bool any = false;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    any = true;
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa > 0 ? 1 : 0;
+    } else {
+      exponent++;
+      truncated |= *p != '0';
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+      any = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa > 0 ? 1 : 0;
+        exponent--;
+      } else {
+        truncated |= *p != '0';
+      }
+    }
+  }
+  if (!any) {
+    return parse_float_slow(start, end, value);
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negative_exp = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative_exp = *p == '-';
+      p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+      return nullptr;
+    }
+    int e = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+      e = std::min(e * 10 + (*p - '0'), 100000);
+    }
+    exponent += negative_exp ? -e : e;
+  }
+  if (p < end && !is_csv_separator(*p)) {
+    return nullptr;
+  }
+
+  // one correctly rounded operation on exact operands gives the nearest
+  // double, which rounds to the nearest float unless it sits exactly halfway
+  // between two floats or is out of the normal float range
+  if (mantissa == 0) {
+    value = negative ? -0.0f : 0.0f;
+    return p;
+  }
+  if (truncated || mantissa > (1ULL << 53) || exponent < -22 ||
+      exponent > 22) {
+    return parse_float_slow(start, end, value);
+  }
+  double d = exponent >= 0 ? (double)mantissa * pow10[exponent]
+                           : (double)mantissa / pow10[-exponent];
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  if ((bits & 0x1fffffffULL) == 0x10000000ULL || d < FLT_MIN || d > FLT_MAX) {
+    return parse_float_slow(start, end, value);
+  }
+  value = (float)(negative ? -d : d);
+  return p;
+}
+
+// number of values in [p, end), where p follows a separator or starts the
+// input. a value starts wherever a separator is followed by anything else.
+static size_t count_values(const char *p, const char *end) {
+  size_t count = 0;
+  bool in_value = false;
+#ifdef AMBER_CSV_SSE2
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i tab = _mm_set1_epi8('\t');
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i sep = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, comma), _mm_cmpeq_epi8(v, space)),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, newline),
+                                  _mm_cmpeq_epi8(v, cr)),
+                     _mm_cmpeq_epi8(v, tab)));
+    unsigned value = ~(unsigned)_mm_movemask_epi8(sep) & 0xffff;
+    unsigned starts = value & ~((value << 1) | (in_value ? 1u : 0u));
+    count += std::bitset<16>(starts).count();
+    in_value = (value >> 15) != 0;
+  }
+#endif
+  for (; p < end; p++) {
+    bool sep = is_csv_separator(*p);
+    count += !sep && !in_value ? 1 : 0;
+    in_value = !sep;
+  }
+  return count;
+}
+
+size_t count_csv_values(const char *data, size_t size) {
+  return count_values(data, data + size);
+}
+
+bool parse_csv_values(const char *&p, const char *end, float *out, size_t max,
+                      size_t &count) {
+  count = 0;
+  while (count < max) {
+    while (p < end && is_csv_separator(*p)) {
+      p++;
+    }
+    if (p == end) {
+      break;
+    }
+    auto next = parse_float(p, end, out[count]);
+    if (next == nullptr) {
+      return false;
+    }
+    count++;
+    p = next;
+  }
+  return true;
+}
+
+// run step for every piece, the first on the calling thread
+static void for_each_piece(size_t pieces,
+                           const std::function<void(size_t)> &step) {
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < pieces; i++) {
+    workers.emplace_back(step, i);
+  }
+  step(0);
+  for (auto &w : workers) {
+    w.join();
+  }
+}
+
+bool parse_csv_floats(const char *data, size_t size, std::vector<float> &out,
+                      size_t threads, size_t *bad) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t pieces = std::max<size_t>(1, std::min(threads, size / min_piece));
+
+  // split at separators so that no value straddles two pieces, preferring
+  // the end of a line
+  const char *end = data + size;
+  std::vector<const char *> bounds{data};
+  for (size_t i = 1; i < pieces; i++) {
+    const char *p = std::max(data + size / pieces * i, bounds.back());
+    const char *line = (const char *)memchr(p, '\n', end - p);
+    if (line != nullptr && line - p < (ptrdiff_t)(size / pieces / 2)) {
+      p = line;
+    }
+    while (p < end && !is_csv_separator(*p)) {
+      p++;
+    }
+    bounds.push_back(p);
+  }
+  bounds.push_back(end);
+
+  // count each piece's values to find where its output goes, then parse
+  // every piece into place
+  std::vector<size_t> offsets(pieces + 1);
+  std::vector<const char *> failed(pieces);
+  for_each_piece(pieces, [&](size_t i) {
+    offsets[i + 1] = count_values(bounds[i], bounds[i + 1]);
+  });
+  for (size_t i = 0; i < pieces; i++) {
+    offsets[i + 1] += offsets[i];
+  }
+  out.resize(offsets[pieces]);
+  for_each_piece(pieces, [&](size_t i) {
+    const char *p = bounds[i];
+    size_t count;
+    bool ok = parse_csv_values(p, bounds[i + 1], out.data() + offsets[i],
+                               offsets[i + 1] - offsets[i], count);
+    failed[i] = ok ? nullptr : p;
+  });
+
+  for (auto f : failed) {
+    if (f != nullptr) {
+      if (bad != nullptr) {
+        *bad = f - data;
+      }
+      return false;
+    }
+  }
+  return true;
+}
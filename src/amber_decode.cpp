@@ -0,0 +1,365 @@
+#include "amber_decode.h"
+#include <functional>
+#include <unordered_map>
+
+using namespace amber_models;
+
+namespace {
+
+enum class field_type {
+  u16,
+  u32,
+  u64,
+  str,
+  vec_i32,
+  vec_u16,
+  vec_u64,
+  vec_f32,
+  mat_f32
+};
+
+template <typename Model> class field {
+public:
+  field_type type;
+  std::function<void *(Model &)> target;
+};
+
+template <typename Model>
+using field_table = std::unordered_map<std::string, field<Model>>;
+
+// add the fields of a PostStreamResponse found below prefix
+template <typename Model>
+void add_stream_fields(field_table<Model> &t, const std::string &prefix,
+                       std::function<PostStreamResponse &(Model &)> base) {
+  auto add = [&](const char *key, field_type type,
+                 std::function<void *(PostStreamResponse &)> member) {
+    t[prefix + key] = field<Model>{
+        type, [base, member](Model &m) { return member(base(m)); }};
+  };
+  add("state", field_type::str, [](PostStreamResponse &r) { return &r.state; });
+  add("message", field_type::str,
+      [](PostStreamResponse &r) { return &r.message; });
+  add("progress", field_type::u16,
+      [](PostStreamResponse &r) { return &r.progress; });
+  add("clusterCount", field_type::u32,
+      [](PostStreamResponse &r) { return &r.clusterCount; });
+  add("retryCount", field_type::u16,
+      [](PostStreamResponse &r) { return &r.retryCount; });
+  add("streamingWindowSize", field_type::u16,
+      [](PostStreamResponse &r) { return &r.streamingWindowSize; });
+  add("totalInferences", field_type::u64,
+      [](PostStreamResponse &r) { return &r.totalInferences; });
+  add("lastModified", field_type::u64,
+      [](PostStreamResponse &r) { return &r.lastModified; });
+  add("lastModifiedDelta", field_type::u64,
+      [](PostStreamResponse &r) { return &r.lastModifiedDelta; });
+  add("ID", field_type::vec_i32,
+      [](PostStreamResponse &r) { return &r.iD.value; });
+  add("RI", field_type::vec_u16,
+      [](PostStreamResponse &r) { return &r.rI.value; });
+  add("SI", field_type::vec_u16,
+      [](PostStreamResponse &r) { return &r.sI.value; });
+  add("AD", field_type::vec_u16,
+      [](PostStreamResponse &r) { return &r.aD.value; });
+  add("AH", field_type::vec_u16,
+      [](PostStreamResponse &r) { return &r.aH.value; });
+  add("AM", field_type::vec_f32,
+      [](PostStreamResponse &r) { return &r.aM.value; });
+  add("AW", field_type::vec_u16,
+      [](PostStreamResponse &r) { return &r.aW.value; });
+  add("NI", field_type::vec_u16,
+      [](PostStreamResponse &r) { return &r.nI.value; });
+  add("NS", field_type::vec_u16,
+      [](PostStreamResponse &r) { return &r.nS.value; });
+  add("NW", field_type::vec_f32,
+      [](PostStreamResponse &r) { return &r.nW.value; });
+  add("OM", field_type::vec_f32,
+      [](PostStreamResponse &r) { return &r.oM.value; });
+}
+
+/**
+ * Generic sax handler. Keys of nested objects are joined with '.' and looked
+ * up in the model's field table; values of unknown keys are skipped.
+ */
+template <typename Model> class model_sax {
+public:
+  model_sax(Model &model, const field_table<Model> &fields)
+      : model(model), fields(fields) {}
+
+  bool null() { return true; }
+
+  bool boolean(bool) { return true; }
+
+  bool number_integer(json::number_integer_t val) {
+    return this->store((double)val, (int64_t)val);
+  }
+
+  bool number_unsigned(json::number_unsigned_t val) {
+    return this->store((double)val, (int64_t)val);
+  }
+
+  bool number_float(json::number_float_t val, const json::string_t &) {
+    return this->store(val, (int64_t)val);
+  }
+
+  bool string(json::string_t &val) {
+    if (this->active() && this->current->type == field_type::str) {
+      *(std::string *)this->target = std::move(val);
+    }
+    return true;
+  }
+
+  bool binary(json::binary_t &) { return true; }
+
+  bool start_object(std::size_t) {
+    if (this->skip > 0 || this->array_depth > 0) {
+      this->skip++;
+      return true;
+    }
+    if (this->object_depth > 0) {
+      this->path += this->last_key + ".";
+    }
+    this->object_depth++;
+    this->current = nullptr;
+    return true;
+  }
+
+  bool end_object() {
+    if (this->skip > 0) {
+      this->skip--;
+      return true;
+    }
+    this->object_depth--;
+    if (this->object_depth > 0 && !this->path.empty()) {
+      this->path.pop_back();
+      this->path.erase(this->path.rfind('.') == std::string::npos
+                           ? 0
+                           : this->path.rfind('.') + 1);
+    }
+    this->current = nullptr;
+    return true;
+  }
+
+  bool start_array(std::size_t) {
+    if (this->skip > 0 || this->current == nullptr) {
+      this->skip++;
+      return true;
+    }
+    this->array_depth++;
+    if (this->array_depth == 1) {
+      this->clear();
+    } else if (this->array_depth == 2 &&
+               this->current->type == field_type::mat_f32) {
+      ((std::vector<std::vector<float>> *)this->target)->emplace_back();
+    }
+    return true;
+  }
+
+  bool end_array() {
+    if (this->skip > 0) {
+      this->skip--;
+      return true;
+    }
+    this->array_depth--;
+    if (this->array_depth == 0) {
+      this->current = nullptr;
+    }
+    return true;
+  }
+
+  bool key(json::string_t &val) {
+    if (this->skip > 0) {
+      return true;
+    }
+    this->last_key = val;
+    auto it = this->fields.find(this->path + val);
+    this->current = nullptr;
+    if (it != this->fields.end()) {
+      // resolve the member once, values are then stored without lookups
+      this->current = &it->second;
+      this->target = it->second.target(this->model);
+    }
+    return true;
+  }
+
+  bool parse_error(std::size_t, const std::string &,
+                   const nlohmann::detail::exception &) {
+    return false;
+  }
+
+private:
+  bool active() { return this->skip == 0 && this->current != nullptr; }
+
+  void clear() {
+    void *target = this->target;
+    switch (this->current->type) {
+    case field_type::vec_i32:
+      ((std::vector<int32_t> *)target)->clear();
+      break;
+    case field_type::vec_u16:
+      ((std::vector<uint16_t> *)target)->clear();
+      break;
+    case field_type::vec_u64:
+      ((std::vector<uint64_t> *)target)->clear();
+      break;
+    case field_type::vec_f32:
+      ((std::vector<float> *)target)->clear();
+      break;
+    case field_type::mat_f32:
+      ((std::vector<std::vector<float>> *)target)->clear();
+      break;
+    default:
+      break;
+    }
+  }
+
+  bool store(double f, int64_t i) {
+    if (!this->active()) {
+      return true;
+    }
+    void *target = this->target;
+    switch (this->current->type) {
+    case field_type::u16:
+      *(uint16_t *)target = (uint16_t)i;
+      break;
+    case field_type::u32:
+      *(uint32_t *)target = (uint32_t)i;
+      break;
+    case field_type::u64:
+      *(uint64_t *)target = (uint64_t)i;
+      break;
+    case field_type::vec_i32:
+      ((std::vector<int32_t> *)target)->push_back((int32_t)i);
+      break;
+    case field_type::vec_u16:
+      ((std::vector<uint16_t> *)target)->push_back((uint16_t)i);
+      break;
+    case field_type::vec_u64:
+      ((std::vector<uint64_t> *)target)->push_back((uint64_t)i);
+      break;
+    case field_type::vec_f32:
+      ((std::vector<float> *)target)->push_back((float)f);
+      break;
+    case field_type::mat_f32: {
+      auto rows = (std::vector<std::vector<float>> *)target;
+      if (this->array_depth == 2 && !rows->empty()) {
+        rows->back().push_back((float)f);
+      }
+    } break;
+    default:
+      break;
+    }
+    return true;
+  }
+
+  Model &model;
+  const field_table<Model> &fields;
+  const field<Model> *current{};
+  void *target{};
+  std::string path;
+  std::string last_key;
+  int object_depth{};
+  int array_depth{};
+  int skip{};
+};
+
+} // namespace
+
+template <typename Model>
+static bool decode(const std::string &body, Model &response,
+                   const field_table<Model> &fields) {
+  model_sax<Model> sax(response, fields);
+  return json::sax_parse(body, &sax);
+}
+
+// reset scalar members, array members are cleared (keeping their capacity)
+// as the decoder reaches them
+static void reset(PostStreamResponse &r) {
+  r.state.clear();
+  r.message.clear();
+  r.progress = 0;
+  r.clusterCount = 0;
+  r.retryCount = 0;
+  r.streamingWindowSize = 0;
+  r.totalInferences = 0;
+  r.lastModified = 0;
+  r.lastModifiedDelta = 0;
+  for (auto v : {&r.rI.value, &r.sI.value, &r.aD.value, &r.aH.value,
+                 &r.aW.value, &r.nI.value, &r.nS.value}) {
+    v->clear();
+  }
+  for (auto v : {&r.aM.value, &r.nW.value, &r.oM.value}) {
+    v->clear();
+  }
+  r.iD.value.clear();
+}
+
+bool decode_response(const std::string &body, PostStreamResponse &response) {
+  static const field_table<PostStreamResponse> fields = [] {
+    field_table<PostStreamResponse> t;
+    add_stream_fields<PostStreamResponse>(
+        t, "", [](PostStreamResponse &r) -> PostStreamResponse & { return r; });
+    return t;
+  }();
+  reset(response);
+  return decode(body, response, fields);
+}
+
+bool decode_response(const std::string &body, PutStreamResponse &response) {
+  static const field_table<PutStreamResponse> fields = [] {
+    field_table<PutStreamResponse> t;
+    t["vector"] = field<PutStreamResponse>{
+        field_type::str, [](PutStreamResponse &r) { return &r.vector; }};
+    add_stream_fields<PutStreamResponse>(
+        t, "results.",
+        [](PutStreamResponse &r) -> PostStreamResponse & { return r.results; });
+    return t;
+  }();
+  response.vector.clear();
+  reset(response.results);
+  return decode(body, response, fields);
+}
+
+bool decode_response(const std::string &body, GetStatusResponse &response) {
+  typedef GetStatusResponse S;
+  static const field_table<S> fields = {
+      {"pca", {field_type::mat_f32, [](S &r) { return &r.pca.value; }}},
+      {"clusterGrowth",
+       {field_type::vec_u64, [](S &r) { return &r.clusterGrowth.value; }}},
+      {"clusterSizes",
+       {field_type::vec_u64, [](S &r) { return &r.clusterSizes.value; }}},
+      {"anomalyIndexes",
+       {field_type::vec_u16, [](S &r) { return &r.anomalyIndexes.value; }}},
+      {"frequencyIndexes",
+       {field_type::vec_u16, [](S &r) { return &r.frequencyIndexes.value; }}},
+      {"distanceIndexes",
+       {field_type::vec_u16, [](S &r) { return &r.distanceIndexes.value; }}},
+      {"totalInferences",
+       {field_type::u64, [](S &r) { return &r.totalInferences; }}},
+      {"numClusters", {field_type::u64, [](S &r) { return &r.numClusters; }}},
+      {"anomalyThreshold",
+       {field_type::u16, [](S &r) { return &r.anomalyThreshold; }}},
+      {"state", {field_type::str, [](S &r) { return &r.state; }}},
+  };
+  response.pca.value.clear();
+  response.clusterGrowth.value.clear();
+  response.clusterSizes.value.clear();
+  response.anomalyIndexes.value.clear();
+  response.frequencyIndexes.value.clear();
+  response.distanceIndexes.value.clear();
+  response.totalInferences = 0;
+  response.numClusters = 0;
+  response.anomalyThreshold = 0;
+  response.state.clear();
+  return decode(body, response, fields);
+}
+
+bool decode_response(const std::string &body, result_store &store) {
+  // decode into the scratch response first, a body that breaks off halfway
+  // must not leave some columns longer than others
+  if (!decode_response(body, store.pending)) {
+    return false;
+  }
+  store.append(store.pending);
+  return true;
+}
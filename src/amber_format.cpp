@@ -0,0 +1,71 @@
+#include "amber_format.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+size_t format_float(char *out, float v) {
+  static const double pow10[] = {1e0, 1e1, 1e2,  1e3,  1e4,  1e5,  1e6,
+                                 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13};
+  static const uint64_t ipow10[] = {1ULL,
+                                    10ULL,
+                                    100ULL,
+                                    1000ULL,
+                                    10000ULL,
+                                    100000ULL,
+                                    1000000ULL,
+                                    10000000ULL,
+                                    100000000ULL,
+                                    1000000000ULL,
+                                    10000000000ULL,
+                                    100000000000ULL,
+                                    1000000000000ULL,
+                                    10000000000000ULL};
+  float a = std::fabs(v);
+  if (a == 0) {
+    out[0] = '0';
+    return 1;
+  }
+  if (std::isfinite(v) && a < 1e9f && a >= 1e-4f) {
+    for (int d = 0; d < 14; d++) {
+      double scaled = std::round((double)a * pow10[d]);
+      if ((float)(scaled / pow10[d]) != a) {
+        continue;
+      }
+
+      // digits are written backwards into a small buffer
+      char buf[32];
+      char *p = buf + sizeof(buf);
+      auto n = (uint64_t)scaled;
+      uint64_t frac = n % ipow10[d];
+      uint64_t whole = n / ipow10[d];
+      for (int i = 0; i < d; i++) {
+        *--p = (char)('0' + frac % 10);
+        frac /= 10;
+      }
+      if (d > 0) {
+        *--p = '.';
+      }
+      do {
+        *--p = (char)('0' + whole % 10);
+        whole /= 10;
+      } while (whole > 0);
+      if (v < 0) {
+        *--p = '-';
+      }
+      size_t len = buf + sizeof(buf) - p;
+      if (len <= float_text_max) {
+        for (size_t i = 0; i < len; i++) {
+          out[i] = p[i];
+        }
+        return len;
+      }
+      break;
+    }
+  }
+  char buf[32];
+  int n = snprintf(buf, sizeof(buf), "%.9g", v);
+  for (int i = 0; i < n; i++) {
+    out[i] = buf[i];
+  }
+  return (size_t)n;
+}
@@ -0,0 +1,202 @@
+#include "amber_fusion.h"
+#include "amber_sdk.h"
+
+fusion_encoder::fusion_encoder(const std::vector<std::string> &labels,
+                               const std::string &submit_rule)
+    : labels(labels) {
+
+  // keys in the order the json document writes them, values start at zero
+  this->text.append("{\"submitRule\":");
+  this->text.append(json(submit_rule).dump());
+  this->text.append(",\"vector\":[");
+  for (size_t i = 0; i < labels.size(); i++) {
+    if (!this->positions.emplace(labels[i], i).second) {
+      throw amber_except("duplicate fusion label: %s", labels[i].c_str());
+    }
+    this->text.append(i > 0 ? ",{\"label\":" : "{\"label\":");
+    this->text.append(json(labels[i]).dump());
+    this->text.append(",\"ts\":\"\",\"value\":");
+    this->slots.push_back(this->text.size());
+    this->text.append(float_text_max, ' ');
+    this->text.push_back('}');
+    this->set(i, 0);
+  }
+  this->text.append("]}");
+}
+
+static std::vector<std::string>
+fusion_labels(const std::vector<amber_models::FusionConfig> &config) {
+  std::vector<std::string> labels;
+  labels.reserve(config.size());
+  for (auto &f : config) {
+    labels.push_back(f.label);
+  }
+  return labels;
+}
+
+fusion_encoder::fusion_encoder(
+    const std::vector<amber_models::FusionConfig> &config,
+    const std::string &submit_rule)
+    : fusion_encoder(fusion_labels(config), submit_rule) {}
+
+size_t fusion_encoder::index(const std::string &label) const {
+  auto it = this->positions.find(label);
+  if (it == this->positions.end()) {
+    throw amber_except("unknown fusion label: %s", label.c_str());
+  }
+  return it->second;
+}
+
+void fusion_encoder::set(const float *values, size_t count) {
+  if (count > this->slots.size()) {
+    count = this->slots.size();
+  }
+  for (size_t i = 0; i < count; i++) {
+    this->set(i, values[i]);
+  }
+}
+
+// fill config from the sensor's configuration when the caller gave none
+static std::vector<amber_models::FusionConfig> &
+load_fusion_config(amber_sdk &amber, const std::string &sensor_id,
+                   std::vector<amber_models::FusionConfig> &config) {
+  if (!config.empty()) {
+    return config;
+  }
+  get_config_response response;
+  auto err = amber.get_config(response, sensor_id);
+  if (err != nullptr) {
+    auto e = amber_except("failed to read configuration of %s: %s",
+                          sensor_id.c_str(), err->message.c_str());
+    delete err;
+    throw e;
+  }
+  for (auto &f : response.features) {
+    config.push_back(amber_models::FusionConfig{f.label, f.submitRule});
+  }
+  return config;
+}
+
+fusion_assembler::fusion_assembler(
+    amber_sdk &amber, const std::string &sensor_id, assembler_options options,
+    result_callback callback, std::vector<amber_models::FusionConfig> config)
+    : handle(amber.prepare_sensor(sensor_id)), options(options),
+      callback(std::move(callback)),
+      encoder(load_fusion_config(amber, sensor_id, config), "submit") {
+  if (this->options.max_queued == 0) {
+    this->options.max_queued = 1;
+  }
+  for (auto &f : config) {
+    this->triggers.push_back(f.submitRule != "nosubmit");
+  }
+  this->current.assign(config.size(), 0);
+  this->present.assign(config.size(), !this->options.wait_complete);
+  this->missing = this->options.wait_complete ? config.size() : 0;
+  this->worker = std::thread(&fusion_assembler::run, this);
+}
+
+fusion_assembler::~fusion_assembler() {
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->stopping = true;
+  }
+  this->cv.notify_all();
+  this->worker.join();
+}
+
+bool fusion_assembler::update(size_t index, float value) {
+  if (index >= this->current.size()) {
+    throw amber_except("fusion feature index %zu out of range", index);
+  }
+  std::unique_lock<std::mutex> guard(this->lock);
+  this->stats.updates++;
+  this->current[index] = value;
+  if (!this->present[index]) {
+    this->present[index] = true;
+    this->missing--;
+  }
+
+  // the server would only merge this value, so neither will we send it
+  if (!this->triggers[index] || this->missing > 0) {
+    this->stats.suppressed++;
+    return false;
+  }
+  this->cv.wait(guard, [this] {
+    return this->pending.size() < this->options.max_queued;
+  });
+  this->capture();
+  return true;
+}
+
+void fusion_assembler::submit() {
+  std::unique_lock<std::mutex> guard(this->lock);
+  this->cv.wait(guard, [this] {
+    return this->pending.size() < this->options.max_queued;
+  });
+  this->capture();
+}
+
+// queue a copy of the current vector for the worker. lock must be held.
+void fusion_assembler::capture() {
+  std::vector<float> v;
+  if (!this->spare.empty()) {
+    v = std::move(this->spare.back());
+    this->spare.pop_back();
+  }
+  v.assign(this->current.begin(), this->current.end());
+  this->pending.push_back(std::move(v));
+  this->cv.notify_all();
+}
+
+void fusion_assembler::drain() {
+  std::unique_lock<std::mutex> guard(this->lock);
+  this->cv.wait(guard,
+                [this] { return this->pending.empty() && !this->sending; });
+}
+
+assembler_stats fusion_assembler::get_stats() {
+  std::lock_guard<std::mutex> guard(this->lock);
+  auto stats = this->stats;
+  stats.queued = this->pending.size() + (this->sending ? 1 : 0);
+  return stats;
+}
+
+void fusion_assembler::run() {
+  std::unique_lock<std::mutex> guard(this->lock);
+  while (true) {
+    this->cv.wait(guard, [this] {
+      return !this->pending.empty() || this->stopping;
+    });
+    if (this->pending.empty()) {
+      break;
+    }
+    std::vector<float> v = std::move(this->pending.front());
+    this->pending.pop_front();
+    this->sending = true;
+    this->cv.notify_all();
+    guard.unlock();
+
+    this->encoder.set(v);
+    stream_fusion_response response;
+    error_response *err;
+    try {
+      err = this->handle->stream_fusion(response, this->encoder);
+    } catch (std::exception &e) {
+      // an exception leaving the worker would end the process
+      err = new error_response{0, e.what()};
+    }
+    bool failed = err != nullptr;
+    if (this->callback) {
+      this->callback(err, response);
+    } else {
+      delete err;
+    }
+
+    guard.lock();
+    this->sending = false;
+    this->stats.submits++;
+    this->stats.errors += failed ? 1 : 0;
+    this->spare.push_back(std::move(v));
+    this->cv.notify_all();
+  }
+}
@@ -0,0 +1,31 @@
+#include "amber_latency.h"
+#include <algorithm>
+
+void latency_tracker::record(const std::string &slug, double ms) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  auto &s = this->slugs[slug];
+  if (s.samples.size() < this->window) {
+    s.samples.push_back(ms);
+    return;
+  }
+  s.samples[s.next] = ms;
+  s.next = (s.next + 1) % this->window;
+}
+
+double latency_tracker::percentile(const std::string &slug, double p,
+                                   size_t min_samples) {
+  std::vector<double> samples;
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    auto it = this->slugs.find(slug);
+    if (it == this->slugs.end() || it->second.samples.empty() ||
+        it->second.samples.size() < min_samples) {
+      return -1;
+    }
+    samples = it->second.samples;
+  }
+  p = std::min(std::max(p, 0.0), 1.0);
+  auto nth = samples.begin() + (size_t)(p * (double)(samples.size() - 1));
+  std::nth_element(samples.begin(), nth, samples.end());
+  return *nth;
+}
@@ -0,0 +1,124 @@
+#include "amber_mmap.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mapped_file::~mapped_file() { this->close(); }
+
+#ifdef _WIN32
+
+bool mapped_file::open(const std::string &path) {
+  this->close();
+  this->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (this->file == INVALID_HANDLE_VALUE) {
+    this->file = nullptr;
+    this->message = "cannot open " + path;
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(this->file, &size)) {
+    this->message = "cannot read the size of " + path;
+    this->close();
+    return false;
+  }
+  this->length = (size_t)size.QuadPart;
+  if (this->length == 0) {
+    return true;
+  }
+  this->mapping =
+      CreateFileMappingA(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (this->mapping != nullptr) {
+    this->begin = (const char *)MapViewOfFile(this->mapping, FILE_MAP_READ, 0,
+                                              0, 0);
+  }
+  if (this->begin == nullptr) {
+    this->message = "cannot map " + path;
+    this->close();
+    return false;
+  }
+  return true;
+}
+
+void mapped_file::close() {
+  if (this->begin != nullptr) {
+    UnmapViewOfFile(this->begin);
+  }
+  if (this->mapping != nullptr) {
+    CloseHandle(this->mapping);
+  }
+  if (this->file != nullptr) {
+    CloseHandle(this->file);
+  }
+  this->begin = nullptr;
+  this->mapping = nullptr;
+  this->file = nullptr;
+  this->length = 0;
+}
+
+void mapped_file::release(size_t, size_t) {
+  // the working set is trimmed by the system, views cannot be partly dropped
+}
+
+#else
+
+bool mapped_file::open(const std::string &path) {
+  this->close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    this->message = "cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+  struct stat st {};
+  if (fstat(fd, &st) != 0) {
+    this->message = "cannot read the size of " + path + ": " + strerror(errno);
+    ::close(fd);
+    return false;
+  }
+  this->length = (size_t)st.st_size;
+  if (this->length > 0) {
+    void *p = mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      this->message = "cannot map " + path + ": " + strerror(errno);
+      this->length = 0;
+      ::close(fd);
+      return false;
+    }
+    this->begin = (const char *)p;
+    madvise(p, this->length, MADV_SEQUENTIAL);
+  }
+
+  // the mapping stays valid without the descriptor
+  ::close(fd);
+  return true;
+}
+
+void mapped_file::close() {
+  if (this->begin != nullptr) {
+    munmap((void *)this->begin, this->length);
+  }
+  this->begin = nullptr;
+  this->length = 0;
+}
+
+void mapped_file::release(size_t offset, size_t count) {
+  static const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+  // only whole pages inside the range can go
+  size_t first = (offset + page - 1) / page * page;
+  size_t last = std::min(offset + count, this->length) / page * page;
+  if (this->begin != nullptr && last > first) {
+    madvise((void *)(this->begin + first), last - first, MADV_DONTNEED);
+  }
+}
+
+#endif
@@ -0,0 +1,223 @@
+#include "amber_pipeline.h"
+#include "amber_decode.h"
+
+stream_pipeline::stream_pipeline(amber_sdk &amber, std::string sensor_id,
+                                 pipeline_options options,
+                                 result_callback callback, bool save_image)
+    : amber(&amber), sensor_id(std::move(sensor_id)), options(options),
+      callback(std::move(callback)), save_image(save_image) {
+  if (this->options.depth == 0) {
+    this->options.depth = 1;
+  }
+
+  // one request at a time until the connection is shared
+  this->stats.window = 1;
+  this->worker = std::thread(&stream_pipeline::run, this);
+}
+
+stream_pipeline::~stream_pipeline() {
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->stopping = true;
+  }
+  this->cv.notify_all();
+  this->worker.join();
+}
+
+uint64_t stream_pipeline::submit(const std::string &csvdata) {
+  amber_models::PostStreamRequest request{this->save_image, csvdata};
+  json j = request;
+  return this->enqueue(j.dump());
+}
+
+uint64_t stream_pipeline::submit(const float *data, size_t count) {
+  std::string body;
+  this->amber->render_stream(body, data, count, this->save_image);
+  return this->enqueue(std::move(body));
+}
+
+uint64_t stream_pipeline::enqueue(std::string body) {
+  std::unique_ptr<batch> b(new batch());
+  b->body = std::move(body);
+  b->context = request_context::current();
+
+  std::unique_lock<std::mutex> guard(this->lock);
+  this->cv.wait(guard, [this] {
+    return this->batches.size() < this->options.depth + this->options.max_queued;
+  });
+  b->seq = this->next_seq++;
+  auto seq = b->seq;
+  this->batches.push_back(std::move(b));
+  this->stats.submitted++;
+  this->cv.notify_all();
+  return seq;
+}
+
+void stream_pipeline::drain() {
+  std::unique_lock<std::mutex> guard(this->lock);
+  this->cv.wait(guard, [this] { return this->batches.empty(); });
+}
+
+pipeline_stats stream_pipeline::get_stats() {
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->stats;
+}
+
+void stream_pipeline::run() {
+  std::unique_lock<std::mutex> guard(this->lock);
+  while (true) {
+
+    // hand out finished batches at the head, in sequence order
+    if (!this->batches.empty() &&
+        this->batches.front()->state == batch_state::done) {
+      std::unique_ptr<batch> b = std::move(this->batches.front());
+      this->batches.pop_front();
+      this->stats.delivered++;
+      this->stats.failed += b->res.code != 200 ? 1 : 0;
+      this->cv.notify_all();
+      guard.unlock();
+      this->deliver(*b);
+      guard.lock();
+      continue;
+    }
+
+    // failed batches are resent once nothing else is in flight
+    if (this->awaiting_retry > 0) {
+      if (this->in_flight == 0) {
+        this->schedule_retries(guard);
+        continue;
+      }
+      this->cv.wait(guard);
+      continue;
+    }
+
+    // send queued batches in order while the window has room
+    batch *next = nullptr;
+    if (this->in_flight < this->stats.window) {
+      for (auto &b : this->batches) {
+        if (b->state == batch_state::queued) {
+          next = b.get();
+          break;
+        }
+      }
+    }
+    if (next != nullptr) {
+      next->state = batch_state::in_flight;
+      this->in_flight++;
+      guard.unlock();
+      this->send(next);
+      guard.lock();
+      continue;
+    }
+
+    if (this->stopping && this->batches.empty()) {
+      break;
+    }
+    this->cv.wait(guard);
+  }
+}
+
+void stream_pipeline::send(batch *b) {
+  auto sdk_req = sdk_request{"POST", "stream"};
+  sdk_req.body = b->body;
+  sdk_req.headers["content-type"] = "application/json";
+  sdk_req.headers["sensorid"] = this->sensor_id;
+  sdk_req.raw_result = true;
+
+  // issue under the bounds of the thread that submitted the batch
+  auto done = [this, b](sdk_response &res) { this->complete(b, res); };
+  auto cancel = b->context.cancel;
+  if (b->context.has_deadline()) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        b->context.deadline - std::chrono::steady_clock::now());
+    request_scope scope(std::max(left, std::chrono::milliseconds(0)), cancel);
+    this->amber->submit_async(std::move(sdk_req), done);
+  } else {
+    request_scope scope(cancel);
+    this->amber->submit_async(std::move(sdk_req), done);
+  }
+}
+
+void stream_pipeline::complete(batch *b, sdk_response &res) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->in_flight--;
+  if (res.code != 0) {
+    this->stats.window = res.multiplexed ? this->options.depth : 1;
+  }
+
+  // refusals and transport failures before the request went out never
+  // reached the sensor, unless the batch itself was cancelled or ran out of
+  // time. a batch that timed out after it was sent may have been ingested
+  // and is not resent, which would feed the sensor its samples twice.
+  bool unsent = res.code == 0 && res.unsent;
+  bool retryable = (unsent || res.code == 429 || res.code == 503) &&
+                   b->context.refusal() == nullptr &&
+                   b->attempts < this->options.max_retries;
+  b->res = std::move(res);
+  if (retryable) {
+    b->state = batch_state::retry;
+    this->awaiting_retry++;
+  } else {
+    b->state = batch_state::done;
+  }
+  this->cv.notify_all();
+}
+
+/**
+ * With nothing in flight, requeue the failed batches that come after the
+ * last accepted one; earlier failures were overtaken and stay failed.
+ * @param guard: holds this->lock, released during the backoff
+ */
+void stream_pipeline::schedule_retries(std::unique_lock<std::mutex> &guard) {
+  size_t accepted = 0; // one past the last accepted batch
+  for (size_t i = 0; i < this->batches.size(); i++) {
+    auto &b = this->batches[i];
+    if (b->state == batch_state::done && b->res.code == 200) {
+      accepted = i + 1;
+    }
+  }
+
+  int attempt = 0;
+  for (size_t i = 0; i < this->batches.size(); i++) {
+    auto &b = this->batches[i];
+    if (b->state != batch_state::retry) {
+      continue;
+    }
+    if (i < accepted) {
+      b->state = batch_state::done;
+      continue;
+    }
+    b->state = batch_state::queued;
+    b->attempts++;
+    attempt = std::max(attempt, b->attempts);
+    this->stats.retried++;
+  }
+  this->awaiting_retry = 0;
+
+  // back off before resending, longer with every attempt, but resend at once
+  // when the pipeline is shutting down rather than hold up its destructor
+  if (attempt > 0) {
+    auto delay = this->options.retry_delay_ms << (attempt - 1);
+    this->cv.wait_for(guard, std::chrono::milliseconds(delay),
+                      [this] { return this->stopping; });
+  }
+}
+
+void stream_pipeline::deliver(batch &b) {
+  stream_sensor_response response{};
+  error_response *err = nullptr;
+  try {
+    if (b.res.code != 200) {
+      err = new error_response(b.res.res.get<error_response>());
+    } else if (!decode_response(b.res.body, response)) {
+      err = new error_response{0, "malformed response"};
+    }
+  } catch (json::exception &e) {
+    err = new error_response{0, e.what()};
+  }
+  if (this->callback) {
+    this->callback(b.seq, err, response);
+  } else {
+    delete err;
+  }
+}
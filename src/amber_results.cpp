@@ -0,0 +1,70 @@
+#include "amber_results.h"
+#include "amber_decode.h"
+
+result_store::result_store(size_t capacity)
+    : cap(capacity > 0 ? capacity : 1), id_column(cap), ri_column(cap),
+      si_column(cap), ad_column(cap), ah_column(cap), am_column(cap),
+      aw_column(cap), ni_column(cap), ns_column(cap), nw_column(cap),
+      om_column(cap) {}
+
+void result_store::append(const amber_models::PostStreamResponse &response) {
+  this->last.state = response.state;
+  this->last.message = response.message;
+  this->last.progress = response.progress;
+  this->last.clusterCount = response.clusterCount;
+  this->last.retryCount = response.retryCount;
+  this->last.streamingWindowSize = response.streamingWindowSize;
+  this->last.totalInferences = response.totalInferences;
+  this->last.lastModified = response.lastModified;
+  this->last.lastModifiedDelta = response.lastModifiedDelta;
+  for (auto v : response.iD.value) {
+    this->id_column.push(v);
+  }
+  for (auto v : response.rI.value) {
+    this->ri_column.push(v);
+  }
+  for (auto v : response.sI.value) {
+    this->si_column.push(v);
+  }
+  for (auto v : response.aD.value) {
+    this->ad_column.push(v);
+  }
+  for (auto v : response.aH.value) {
+    this->ah_column.push(v);
+  }
+  for (auto v : response.aM.value) {
+    this->am_column.push(v);
+  }
+  for (auto v : response.aW.value) {
+    this->aw_column.push(v);
+  }
+  for (auto v : response.nI.value) {
+    this->ni_column.push(v);
+  }
+  for (auto v : response.nS.value) {
+    this->ns_column.push(v);
+  }
+  for (auto v : response.nW.value) {
+    this->nw_column.push(v);
+  }
+  for (auto v : response.oM.value) {
+    this->om_column.push(v);
+  }
+}
+
+bool result_store::append(const std::string &body) {
+  return decode_response(body, *this);
+}
+
+void result_store::clear() {
+  this->last = amber_models::PostStreamResponse{};
+  for (auto c : {&this->ri_column, &this->si_column, &this->ad_column,
+                 &this->ah_column, &this->aw_column, &this->ni_column,
+                 &this->ns_column}) {
+    c->clear();
+  }
+  for (auto c : {&this->am_column, &this->nw_column, &this->om_column}) {
+    c->clear();
+  }
+  this->id_column.clear();
+}
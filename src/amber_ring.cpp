@@ -0,0 +1,102 @@
+#include "amber_ring.h"
+#include "amber_sdk.h"
+#include <thread>
+
+ingest_queue::ingest_queue(const ingest_options &options)
+    : policy(options.policy) {
+  if (options.multi_producer) {
+    this->multi.reset(new mpsc_ring<float>(options.capacity));
+  } else {
+    this->single.reset(new spsc_ring<float>(options.capacity));
+  }
+  if (this->policy == overload_policy::spill) {
+    this->spill = options.spill_path.empty()
+                      ? tmpfile()
+                      : fopen(options.spill_path.c_str(), "w+b");
+    if (this->spill == nullptr) {
+      throw amber_except("failed to open spill file '%s'",
+                         options.spill_path.c_str());
+    }
+  }
+}
+
+ingest_queue::~ingest_queue() {
+  if (this->spill != nullptr) {
+    fclose(this->spill);
+  }
+}
+
+/**
+ * Slow path of push, taken when the ring is full or samples are spilled.
+ */
+bool ingest_queue::overflow(float sample) {
+  switch (this->policy) {
+  case overload_policy::drop_newest:
+    this->dropped++;
+    return false;
+
+  case overload_policy::drop_oldest: {
+    float oldest;
+    while (!this->try_push(sample)) {
+      if (this->try_pop(oldest)) {
+        this->dropped++;
+      }
+    }
+    return true;
+  }
+
+  case overload_policy::spill: {
+    std::lock_guard<std::mutex> guard(this->spill_lock);
+
+    // the consumer may have caught up in the meantime
+    if (!this->spilling.load() && this->try_push(sample)) {
+      return true;
+    }
+    fseek(this->spill, (long)(this->write_pos * sizeof(float)), SEEK_SET);
+    if (fwrite(&sample, sizeof(float), 1, this->spill) != 1) {
+      this->dropped++;
+      return false;
+    }
+    this->write_pos++;
+    this->spilled++;
+    this->spilling.store(true, std::memory_order_release);
+    return true;
+  }
+
+  default:
+    while (!this->try_push(sample)) {
+      std::this_thread::yield();
+    }
+    return true;
+  }
+}
+
+size_t ingest_queue::pop(float *out, size_t max) {
+  size_t n = this->multi ? this->multi->pop(out, max)
+                         : this->single->pop(out, max);
+  if (n == max || !this->spilling.load(std::memory_order_acquire)) {
+    return n;
+  }
+
+  // the ring is drained, continue with the spilled samples behind it
+  std::lock_guard<std::mutex> guard(this->spill_lock);
+  auto want = std::min<uint64_t>(max - n, this->write_pos - this->read_pos);
+  fflush(this->spill);
+  fseek(this->spill, (long)(this->read_pos * sizeof(float)), SEEK_SET);
+  auto got = fread(out + n, sizeof(float), want, this->spill);
+  this->read_pos += got;
+  if (this->read_pos == this->write_pos) {
+    this->read_pos = 0;
+    this->write_pos = 0;
+    this->spilling.store(false, std::memory_order_release);
+  }
+  return n + got;
+}
+
+ingest_stats ingest_queue::get_stats() const {
+  std::lock_guard<std::mutex> guard(this->spill_lock);
+  auto ring_capacity =
+      this->multi ? this->multi->capacity() : this->single->capacity();
+  return ingest_stats{this->size() + (size_t)(this->write_pos - this->read_pos),
+                      ring_capacity, this->dropped.load(), this->spilled};
+}
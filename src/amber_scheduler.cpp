@@ -0,0 +1,193 @@
+#include "amber_scheduler.h"
+#include <algorithm>
+
+stream_scheduler::stream_scheduler(amber_sdk &amber, scheduler_options options,
+                                   result_callback callback)
+    : amber(&amber), options(options), callback(std::move(callback)) {
+  size_t count = this->options.workers;
+  if (count == 0) {
+    count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (this->options.quantum == 0) {
+    this->options.quantum = 1;
+  }
+  for (size_t i = 0; i < count; i++) {
+    this->shards.emplace_back(new shard());
+  }
+  for (size_t i = 0; i < count; i++) {
+    this->workers.emplace_back(&stream_scheduler::run, this, i);
+  }
+}
+
+stream_scheduler::~stream_scheduler() {
+  this->drain();
+  {
+    std::lock_guard<std::mutex> guard(this->idle_lock);
+    this->stopping = true;
+  }
+  this->idle_cv.notify_all();
+  for (auto &w : this->workers) {
+    w.join();
+  }
+}
+
+void stream_scheduler::enqueue(const std::string &sensor_id,
+                               std::string csvdata) {
+  this->add(sensor_id, batch{std::move(csvdata), {}, false});
+}
+
+void stream_scheduler::enqueue(const std::string &sensor_id, const float *data,
+                               size_t count) {
+  this->add(sensor_id,
+            batch{std::string(), std::vector<float>(data, data + count), true});
+}
+
+void stream_scheduler::add(const std::string &sensor_id, batch b) {
+  auto &home = *this->shards[std::hash<std::string>()(sensor_id) %
+                             this->shards.size()];
+  this->queued++;
+  bool woke = false;
+  {
+    std::lock_guard<std::mutex> guard(home.lock);
+    auto &s = home.sensors[sensor_id];
+    if (!s) {
+      s.reset(new sensor());
+      s->id = sensor_id;
+    }
+    s->pending.push_back(std::move(b));
+
+    // a sensor already queued or being served picks the batch up in order
+    if (!s->scheduled) {
+      s->scheduled = true;
+      home.runnable.push_back(s.get());
+      woke = true;
+    }
+  }
+  if (woke) {
+    {
+      std::lock_guard<std::mutex> guard(this->idle_lock);
+      this->runnable++;
+    }
+    this->idle_cv.notify_one();
+  }
+}
+
+void stream_scheduler::drain() {
+  std::unique_lock<std::mutex> guard(this->idle_lock);
+  this->drained_cv.wait(guard, [this] { return this->queued.load() == 0; });
+}
+
+scheduler_stats stream_scheduler::get_stats() {
+  return scheduler_stats{this->stat_batches.load(), this->stat_errors.load(),
+                         this->stat_steals.load(), this->queued.load()};
+}
+
+void stream_scheduler::run(size_t index) {
+  while (true) {
+    size_t home;
+    auto s = this->next(index, home);
+    if (s != nullptr) {
+      this->serve(home, s);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(this->idle_lock);
+    this->idle_cv.wait(guard, [this] {
+      return this->runnable > 0 || this->stopping;
+    });
+    if (this->stopping && this->runnable <= 0) {
+      break;
+    }
+  }
+}
+
+/**
+ * Take the next runnable sensor, from the front of the worker's own shard or
+ * failing that from the back of another's.
+ * @param home: set to the shard the sensor belongs to
+ */
+stream_scheduler::sensor *stream_scheduler::next(size_t index, size_t &home) {
+  size_t count = this->shards.size();
+  for (size_t k = 0; k < count; k++) {
+    home = (index + k) % count;
+    auto &sh = *this->shards[home];
+    sensor *s = nullptr;
+    {
+      std::lock_guard<std::mutex> guard(sh.lock);
+      if (sh.runnable.empty()) {
+        continue;
+      }
+      if (k == 0) {
+        s = sh.runnable.front();
+        sh.runnable.pop_front();
+      } else {
+        s = sh.runnable.back();
+        sh.runnable.pop_back();
+      }
+    }
+    if (k > 0) {
+      this->stat_steals++;
+    }
+    std::lock_guard<std::mutex> guard(this->idle_lock);
+    this->runnable--;
+    return s;
+  }
+  return nullptr;
+}
+
+// send up to a quantum of the sensor's batches, then requeue it if more wait
+void stream_scheduler::serve(size_t home, sensor *s) {
+  auto &sh = *this->shards[home];
+  for (size_t i = 0; i < this->options.quantum; i++) {
+    batch b;
+    {
+      std::lock_guard<std::mutex> guard(sh.lock);
+      if (s->pending.empty()) {
+        break;
+      }
+      b = std::move(s->pending.front());
+      s->pending.pop_front();
+    }
+
+    stream_sensor_response response;
+    error_response *err;
+    try {
+      err = b.packed ? this->amber->stream_sensor(response, s->id,
+                                                  b.samples.data(),
+                                                  b.samples.size(),
+                                                  this->options.save_image)
+                     : this->amber->stream_sensor(response, s->id,
+                                                  std::move(b.csvdata),
+                                                  this->options.save_image);
+    } catch (std::exception &e) {
+      // an exception leaving a worker would end the process
+      err = new error_response{0, e.what()};
+    }
+    this->stat_batches++;
+    this->stat_errors += err != nullptr ? 1 : 0;
+    if (this->callback) {
+      this->callback(s->id, err, response);
+    } else {
+      delete err;
+    }
+
+    if (this->queued.fetch_sub(1) == 1) {
+      std::lock_guard<std::mutex> guard(this->idle_lock);
+      this->drained_cv.notify_all();
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(sh.lock);
+    if (s->pending.empty()) {
+      s->scheduled = false;
+      return;
+    }
+    sh.runnable.push_back(s);
+  }
+  {
+    std::lock_guard<std::mutex> guard(this->idle_lock);
+    this->runnable++;
+  }
+  this->idle_cv.notify_one();
+}
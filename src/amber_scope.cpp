@@ -0,0 +1,73 @@
+#include "amber_scope.h"
+#include <algorithm>
+#include <thread>
+
+void cancel_token::cancel() {
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->flag = true;
+  }
+  this->cv.notify_all();
+}
+
+void cancel_token::wait_until(std::chrono::steady_clock::time_point until) {
+  std::unique_lock<std::mutex> guard(this->lock);
+  this->cv.wait_until(guard, until, [this] { return this->flag.load(); });
+}
+
+long request_context::remaining_ms() const {
+  auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  this->deadline - std::chrono::steady_clock::now())
+                  .count();
+  return std::max<long>(1, (long)left);
+}
+
+const char *request_context::refusal() const {
+  if (this->cancel != nullptr && this->cancel->cancelled()) {
+    return "cancelled";
+  }
+  if (this->has_deadline() &&
+      std::chrono::steady_clock::now() >= this->deadline) {
+    return "deadline exceeded";
+  }
+  return nullptr;
+}
+
+void request_context::wait(long ms) const {
+  auto until = std::min(this->deadline, std::chrono::steady_clock::now() +
+                                            std::chrono::milliseconds(ms));
+  if (this->cancel != nullptr) {
+    this->cancel->wait_until(until);
+  } else {
+    std::this_thread::sleep_until(until);
+  }
+}
+
+request_context &request_context::mutable_current() {
+  static thread_local request_context context;
+  return context;
+}
+
+const request_context &request_context::current() {
+  return mutable_current();
+}
+
+request_scope::request_scope(std::chrono::milliseconds budget,
+                             cancel_token *cancel)
+    : saved(request_context::mutable_current()) {
+  auto &context = request_context::mutable_current();
+  context.deadline = std::min(context.deadline,
+                              std::chrono::steady_clock::now() + budget);
+  if (cancel != nullptr) {
+    context.cancel = cancel;
+  }
+}
+
+request_scope::request_scope(cancel_token *cancel)
+    : saved(request_context::mutable_current()) {
+  if (cancel != nullptr) {
+    request_context::mutable_current().cancel = cancel;
+  }
+}
+
+request_scope::~request_scope() { request_context::mutable_current() = saved; }
@@ -1,5 +1,16 @@
 #include "amber_sdk.h"
+#include "amber_base64.h"
+#include "amber_checkpoint.h"
+#include "amber_csv.h"
+#include "amber_decode.h"
+#include "amber_format.h"
+#include "amber_fusion.h"
+#include "amber_mmap.h"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
 #include <fstream>
 #include <sstream>
 #include <utility>
@@ -18,8 +29,6 @@ using json = nlohmann::json;
 
 const char *user_agent = "User-Agent: amber-cpp-sdk";
 
-std::string compress_string(const std::string &str);
-
 /**
  * Main client which interfaces with the Amber cloud. Amber account
  * credentials are discovered within a .Amber.license file located in the
@@ -53,9 +62,7 @@ std::string compress_string(const std::string &str);
 bool amber_sdk::amber_init(const std::string &l_id, const std::string &l_file,
                            bool verify_cert, const std::string &cert,
                            const std::string &cainfo) {
-  this->auth_time = 0;
-  this->expires_in = 0;
-  this->auth_ok = false;
+  std::atomic_store(&this->token, std::shared_ptr<const auth_token>());
 
   // store license_file and license_id.  default values for these will be filled
   // in by constructors
@@ -152,10 +159,269 @@ bool amber_sdk::amber_init(const std::string &l_id, const std::string &l_file,
   if (this->license.server.compare("") == 0) {
     throw amber_except("server not specified");
   }
+
+  this->init_transport();
   return true;
 }
 
-amber_sdk::~amber_sdk() = default;
+amber_sdk::~amber_sdk() {
+  this->disable_token_refresh();
+
+  // finish outstanding asynchronous requests while the pool is still valid
+  this->engine.reset();
+
+  // easy handles must be detached before the share handle can be released
+  for (auto curl : this->idle_handles) {
+    curl_easy_cleanup(curl);
+  }
+  this->idle_handles.clear();
+  if (this->share != nullptr) {
+    curl_share_cleanup(this->share);
+  }
+}
+
+static void share_lock(CURL *, curl_lock_data data, curl_lock_access,
+                       void *userp) {
+  ((std::mutex *)userp)[data].lock();
+}
+
+static void share_unlock(CURL *, curl_lock_data data, void *userp) {
+  ((std::mutex *)userp)[data].unlock();
+}
+
+/**
+ * Create the share handle used by all pooled easy handles of this client.
+ * Connections, dns lookups and tls sessions are shared so a request issued on
+ * any pooled handle can reuse a live keep-alive connection.
+ */
+void amber_sdk::init_transport() {
+  if (this->share != nullptr) {
+    return;
+  }
+  this->share = curl_share_init();
+  if (this->share == nullptr) {
+    throw amber_except("failed to create curl share handle");
+  }
+  curl_share_setopt(this->share, CURLSHOPT_LOCKFUNC, share_lock);
+  curl_share_setopt(this->share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+  curl_share_setopt(this->share, CURLSHOPT_USERDATA, this->share_locks);
+  curl_share_setopt(this->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(this->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  curl_share_setopt(this->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+}
+
+/**
+ * Set the number of idle connections (and easy handles) kept alive for reuse.
+ * @param pool_size: maximum number of cached connections, at least 1
+ */
+void amber_sdk::set_connection_pool_size(size_t pool_size) {
+  std::lock_guard<std::mutex> guard(this->pool_lock);
+  this->conn.pool_size = pool_size > 0 ? pool_size : 1;
+  while (this->idle_handles.size() > this->conn.pool_size) {
+    curl_easy_cleanup(this->idle_handles.back());
+    this->idle_handles.pop_back();
+  }
+}
+
+connection_stats amber_sdk::get_connection_stats() {
+  return connection_stats{this->stat_requests.load(), this->stat_opened.load(),
+                          this->stat_reused.load()};
+}
+
+CURL *amber_sdk::acquire_handle() {
+  CURL *curl = nullptr;
+  {
+    std::lock_guard<std::mutex> guard(this->pool_lock);
+    if (!this->idle_handles.empty()) {
+      curl = this->idle_handles.back();
+      this->idle_handles.pop_back();
+    }
+  }
+  if (curl != nullptr) {
+    // options are cleared but connections, dns and tls caches survive
+    curl_easy_reset(curl);
+    return curl;
+  }
+  curl = curl_easy_init();
+  if (curl == nullptr) {
+    throw amber_except("failed to create curl handle");
+  }
+  curl_easy_setopt(curl, CURLOPT_SHARE, this->share);
+  return curl;
+}
+
+void amber_sdk::release_handle(CURL *curl) {
+  std::lock_guard<std::mutex> guard(this->pool_lock);
+  if (this->idle_handles.size() < this->conn.pool_size) {
+    this->idle_handles.push_back(curl);
+    return;
+  }
+  curl_easy_cleanup(curl);
+}
+
+void amber_sdk::record_connects(CURL *curl) {
+  long connects = 0;
+  curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+  this->stat_requests++;
+  if (connects > 0) {
+    this->stat_opened += connects;
+  } else {
+    this->stat_reused++;
+  }
+}
+
+static void check_compression(int level) {
+  if (level != compression_level_auto && (level < 0 || level > 9)) {
+    throw amber_except("invalid compression level %d", level);
+  }
+}
+
+/**
+ * Configure compression of request bodies, pretrain uploads included.
+ * @param codec: encoding applied to bodies, compression_codec::none to disable
+ * @param level: zlib level 1 (fastest) to 9 (smallest), or
+ * compression_level_auto to choose from measured ratio and cpu time
+ * @param threshold: bodies smaller than this are sent as is
+ */
+void amber_sdk::set_compression(compression_codec codec, int level,
+                                size_t threshold) {
+  check_compression(level);
+  this->compressor.configure(codec, level, threshold);
+  this->pretrain_compressor.configure(codec, level, threshold);
+}
+
+/**
+ * Configure compression of pretrain uploads only, see set_compression.
+ */
+void amber_sdk::set_pretrain_compression(compression_codec codec, int level,
+                                         size_t threshold) {
+  check_compression(level);
+  this->pretrain_compressor.configure(codec, level, threshold);
+}
+
+/**
+ * Let several chunks of an xl pretrain upload at once. The first chunk always
+ * goes alone, since its response opens the transaction the others join, and
+ * with more than one in flight chunks may reach the server out of order.
+ * Encoding the next chunk overlaps the upload whatever the setting.
+ * @param chunks_in_flight: chunks uploaded at once, 1 keeps them in order
+ */
+void amber_sdk::set_pretrain_concurrency(size_t chunks_in_flight) {
+  if (chunks_in_flight == 0) {
+    throw amber_except("pretrain concurrency must be at least 1");
+  }
+  this->pretraining.in_flight = chunks_in_flight;
+}
+
+/**
+ * Choose how xl pretrain data is split into chunks. Fixed chunks all hold
+ * initial_samples. Adaptive chunks start there and then follow the measured
+ * upload rate, so each takes about target_seconds to send.
+ *
+ * Every chunk tells the server the chunk count, which adaptive sizing can
+ * only estimate until the last chunk is encoded, so the count announced may
+ * change during an upload; the last chunk always carries the final one.
+ */
+void amber_sdk::set_pretrain_chunking(const pretrain_chunk_options &options) {
+  if (options.min_samples == 0 || options.min_samples > options.max_samples ||
+      options.initial_samples < options.min_samples ||
+      options.initial_samples > options.max_samples) {
+    throw amber_except("pretrain chunk sizes need 0 < min_samples <= "
+                       "initial_samples <= max_samples");
+  }
+  if (!(options.target_seconds > 0)) {
+    throw amber_except("pretrain chunk target_seconds must be positive");
+  }
+  this->pretrain_chunks.set_options(options);
+}
+
+body_compressor &amber_sdk::compressor_for(const sdk_request &req) {
+  return req.slug == "pretrain" ? this->pretrain_compressor : this->compressor;
+}
+
+// feed the upload rate of a finished transfer back to its compressor
+void amber_sdk::record_upload(body_compressor *c, CURL *curl) {
+  curl_off_t bytes = 0, speed = 0;
+  curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &bytes);
+  curl_easy_getinfo(curl, CURLINFO_SPEED_UPLOAD_T, &speed);
+  c->record_upload((uint64_t)bytes, (double)speed);
+}
+
+// append s to out as a quoted json string
+static void append_json_string(std::string &out, const std::string &s) {
+  static const char *hex = "0123456789abcdef";
+  out.push_back('"');
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      out.append("\\\"");
+      break;
+    case '\\':
+      out.append("\\\\");
+      break;
+    default:
+      if ((unsigned char)c < 0x20) {
+        out.append("\\u00");
+        out.push_back(hex[(c >> 4) & 0xf]);
+        out.push_back(hex[c & 0xf]);
+      } else {
+        out.push_back(c);
+      }
+    }
+  }
+  out.push_back('"');
+}
+
+// append v to out in the shortest plain decimal form that reads back as the
+// same float
+static void append_csv_float(std::string &out, float v) {
+  char buf[float_text_max];
+  out.append(buf, format_float(buf, v));
+}
+
+// append the base64 encoding of in to out, writing in place
+static void base64_append(std::string &out, const unsigned char *in,
+                          uint64_t len) {
+  size_t at = out.size();
+  out.resize(at + base64_size(len));
+  base64_encode_into(&out[at], in, len);
+}
+
+// render a stream request body for float samples, either as base64 packed
+// little endian float32 or as csv
+static void render_float_stream(std::string &body, const float *data,
+                                size_t count, bool save_image, bool packed) {
+  body.clear();
+  body.append(save_image ? "{\"saveImage\":true,\"data\":\""
+                         : "{\"saveImage\":false,\"data\":\"");
+  if (packed) {
+    base64_append(body, (const unsigned char *)data, count * 4);
+    body.append("\",\"format\":\"packed-float\"}");
+    return;
+  }
+  body.reserve(body.size() + count * 10 + 2);
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0) {
+      body.push_back(',');
+    }
+    append_csv_float(body, data[i]);
+  }
+  body.append("\"}");
+}
+
+template <typename T>
+static std::shared_ptr<std::promise<async_result<T>>> make_promise() {
+  return std::make_shared<std::promise<async_result<T>>>();
+}
+
+// adapt a promise to the completion callback of an asynchronous endpoint
+template <typename T>
+static std::function<void(error_response *, T &)>
+fulfill(std::shared_ptr<std::promise<async_result<T>>> promise) {
+  return [promise](error_response *err, T &response) {
+    promise->set_value(async_result<T>{err, std::move(response)});
+  };
+}
 
 static size_t WriteCallback(void *contents, size_t size, size_t nmemb,
                             void *userp) {
@@ -163,6 +429,67 @@ static size_t WriteCallback(void *contents, size_t size, size_t nmemb,
   return size * nmemb;
 }
 
+// message reported for a failed transfer
+static std::string transfer_error(CURLcode result, const char *error_buffer) {
+  if (result == CURLE_ABORTED_BY_CALLBACK) {
+    return "cancelled";
+  }
+  if (result == CURLE_OPERATION_TIMEDOUT) {
+    return "deadline exceeded";
+  }
+  return error_buffer[0] != '\0' ? std::string(error_buffer)
+                                  : std::string(curl_easy_strerror(result));
+}
+
+// fail the request in res when the calling thread's deadline has passed or
+// its token was cancelled
+static bool refuse_expired(sdk_response &res) {
+  auto reason = request_context::current().refusal();
+  if (reason == nullptr) {
+    return true;
+  }
+  res.code = 0;
+  res.res = {{"code", 0}, {"message", reason}};
+  return false;
+}
+
+// progress callback aborting the transfer once its token is cancelled
+static int cancel_progress(void *clientp, curl_off_t, curl_off_t, curl_off_t,
+                           curl_off_t) {
+  return ((cancel_token *)clientp)->cancelled() ? 1 : 0;
+}
+
+// decode a successful result into its model. the streaming and status models
+// are decoded straight from the raw body, the rest through the json document.
+template <typename T>
+static error_response *decode_result(sdk_response &res, T &response) {
+  response = res.res.get<T>();
+  return nullptr;
+}
+
+template <typename T>
+static error_response *decode_raw_result(sdk_response &res, T &response) {
+  if (!decode_response(res.body, response)) {
+    return new error_response{0, "malformed response"};
+  }
+  return nullptr;
+}
+
+static error_response *decode_result(sdk_response &res,
+                                     stream_sensor_response &response) {
+  return decode_raw_result(res, response);
+}
+
+static error_response *decode_result(sdk_response &res,
+                                     stream_fusion_response &response) {
+  return decode_raw_result(res, response);
+}
+
+static error_response *decode_result(sdk_response &res,
+                                     get_status_response &response) {
+  return decode_raw_result(res, response);
+}
+
 error_response *amber_sdk::create_sensor(create_sensor_response &response,
                                          std::string label) {
 
@@ -247,6 +574,7 @@ amber_sdk::stream_fusion(stream_fusion_response &response,
   sdk_req.body = j.dump();
   sdk_req.headers["content-type"] = "application/json";
   sdk_req.headers["sensorid"] = sensor_id;
+  sdk_req.raw_result = true;
 
   // call api and process results
   sdk_response sdk_res;
@@ -254,8 +582,31 @@ amber_sdk::stream_fusion(stream_fusion_response &response,
   if (sdk_res.code != 200) {
     return new error_response(sdk_res.res.get<amber_models::Error>());
   }
-  response = sdk_res.res.get<stream_fusion_response>();
-  return nullptr;
+  return decode_result(sdk_res, response);
+}
+
+/**
+ * Stream the current vector of a fusion encoder, skipping the json document.
+ * @param encoder: encoder holding the values to send
+ */
+error_response *amber_sdk::stream_fusion(stream_fusion_response &response,
+                                         const std::string &sensor_id,
+                                         const fusion_encoder &encoder) {
+
+  // the encoder body is already the request json
+  auto sdk_req = sdk_request{"PUT", "stream"};
+  sdk_req.body = encoder.body();
+  sdk_req.headers["content-type"] = "application/json";
+  sdk_req.headers["sensorid"] = sensor_id;
+  sdk_req.raw_result = true;
+
+  // call api and process results
+  sdk_response sdk_res;
+  this->call_api(sdk_req, sdk_res);
+  if (sdk_res.code != 200) {
+    return new error_response(sdk_res.res.get<amber_models::Error>());
+  }
+  return decode_result(sdk_res, response);
 }
 
 error_response *amber_sdk::get_sensor(get_sensor_response &response,
@@ -343,6 +694,7 @@ error_response *amber_sdk::stream_sensor(stream_sensor_response &response,
   sdk_req.body = j.dump();
   sdk_req.headers["content-type"] = "application/json";
   sdk_req.headers["sensorid"] = sensor_id;
+  sdk_req.raw_result = true;
 
   // call api and process results
   sdk_response sdk_res;
@@ -350,148 +702,863 @@ error_response *amber_sdk::stream_sensor(stream_sensor_response &response,
   if (sdk_res.code != 200) {
     return new error_response(sdk_res.res.get<error_response>());
   }
-  response = sdk_res.res.get<stream_sensor_response>();
-  return nullptr;
+  return decode_result(sdk_res, response);
 }
 
-error_response *amber_sdk::enable_learning(enable_learning_response &response,
-                                           const std::string &sensor_id,
-                                           uint32_t anomaly_history_window,
-                                           uint64_t learning_rate_numerator,
-                                           uint64_t learning_rate_denominator,
-                                           uint16_t learning_max_clusters,
-                                           uint64_t learning_max_samples) {
+/**
+ * Stream float samples, sent packed when the server accepts packed-float
+ * (see set_stream_format) and as csv otherwise. Saves formatting the samples
+ * as text on the client and parsing them on the server.
+ * @param data: samples, feature values interleaved for fusion sensors
+ * @param count: number of samples
+ */
+error_response *amber_sdk::stream_sensor(stream_sensor_response &response,
+                                         const std::string &sensor_id,
+                                         const float *data, size_t count,
+                                         bool save_image) {
 
-  // generate sdk request object
-  amber_models::LearningParameters streaming{
-      learning_rate_numerator, learning_rate_denominator, learning_max_clusters,
-      learning_max_samples};
-  std::vector<amber_models::FusionConfig> fusion_config;
-  amber_models::PutConfigRequest request{fusion_config, streaming};
-  json j = request;
-  j.erase("features");
-  auto sdk_req = sdk_request{"PUT", "config"};
-  sdk_req.body = j.dump();
-  sdk_req.headers["content-type"] = "application/json";
-  sdk_req.headers["sensorid"] = sensor_id;
+  auto send = [this, &sensor_id](std::string &body, sdk_response &res) {
+    auto sdk_req = sdk_request{"POST", "stream"};
+    sdk_req.body = std::move(body);
+    sdk_req.headers["content-type"] = "application/json";
+    sdk_req.headers["sensorid"] = sensor_id;
+    sdk_req.raw_result = true;
+    this->call_api(sdk_req, res);
+  };
 
   // call api and process results
+  std::string body;
   sdk_response sdk_res;
-  this->call_api(sdk_req, sdk_res);
+  this->send_float_stream(body, data, count, save_image, send, sdk_res);
   if (sdk_res.code != 200) {
     return new error_response(sdk_res.res.get<error_response>());
   }
-  response = sdk_res.res.get<enable_learning_response>();
-  return nullptr;
+  return decode_result(sdk_res, response);
 }
 
-error_response *amber_sdk::post_outage(post_outage_response &response,
-                                       const std::string &sensor_id) {
+/**
+ * Render float samples in the configured stream format and send them. In
+ * automatic mode a 400 to a packed request is retried as csv, and the answer
+ * settles the format for later requests: csv if it was accepted, and csv as
+ * well if it was refused too, since the 400 then tells nothing about packed
+ * input and probing again would double every failing request. Only a server
+ * that has accepted packed-float keeps getting it.
+ */
+void amber_sdk::send_float_stream(
+    std::string &body, const float *data, size_t count, bool save_image,
+    const std::function<void(std::string &, sdk_response &)> &send,
+    sdk_response &res) {
+  auto format = this->streaming.format;
+  bool packed = format == stream_format::packed_float ||
+                (format == stream_format::automatic &&
+                 this->streaming.packed.load() >= 0);
+  render_float_stream(body, data, count, save_image, packed);
+  send(body, res);
+  if (!packed || format != stream_format::automatic) {
+    return;
+  }
+  if (res.code == 200) {
+    this->streaming.packed = 1;
+    return;
+  }
+  if (res.code != 400 || this->streaming.packed.load() == 1) {
+    return;
+  }
+  render_float_stream(body, data, count, save_image, false);
+  send(body, res);
+  if (res.code == 200 || res.code == 400) {
+    int unknown = 0;
+    this->streaming.packed.compare_exchange_strong(unknown, -1);
+  }
+}
+
+/**
+ * Render float samples without probing the server: packed only when packed is
+ * forced or already known to be accepted, csv otherwise.
+ */
+void amber_sdk::render_stream(std::string &body, const float *data,
+                              size_t count, bool save_image) {
+  bool packed = this->streaming.format == stream_format::packed_float ||
+                (this->streaming.format == stream_format::automatic &&
+                 this->streaming.packed.load() == 1);
+  render_float_stream(body, data, count, save_image, packed);
+}
+
+void amber_sdk::stream_sensor_async(
+    const std::string &sensor_id, std::string csvdata, bool save_image,
+    std::function<void(error_response *, stream_sensor_response &)> callback) {
 
   // generate sdk request object
-  auto sdk_req = sdk_request{"POST", "outage"};
+  amber_models::PostStreamRequest request{save_image, std::move(csvdata)};
+  json j = request;
+  auto sdk_req = sdk_request{"POST", "stream"};
+  sdk_req.body = j.dump();
   sdk_req.headers["content-type"] = "application/json";
   sdk_req.headers["sensorid"] = sensor_id;
+  sdk_req.raw_result = true;
 
-  // call api and process results
-  sdk_response sdk_res;
-  this->call_api(sdk_req, sdk_res);
-  if (sdk_res.code != 200) {
-    return new error_response(sdk_res.res.get<error_response>());
-  }
-  response = sdk_res.res.get<post_outage_response>();
-  return nullptr;
+  this->call_api_async<stream_sensor_response>(std::move(sdk_req), callback);
 }
 
-error_response *
-amber_sdk::pretrain_sensor_xl(pretrain_sensor_response &response,
-                              const std::string &sensor_id, std::string csvdata,
-                              bool autotuneConfig, bool blocking) {
+std::future<async_result<stream_sensor_response>>
+amber_sdk::stream_sensor_async(const std::string &sensor_id,
+                               std::string csvdata, bool save_image) {
+  auto promise = make_promise<stream_sensor_response>();
+  this->stream_sensor_async(sensor_id, std::move(csvdata), save_image,
+                            fulfill(promise));
+  return promise->get_future();
+}
 
-  // parse csv data into float vector
-  std::vector<float> packed_floats;
-  std::stringstream ss(csvdata);
-  for (float i; ss >> i;) {
-    packed_floats.push_back(i);
-    if (ss.peek() == ',' || isspace(ss.peek()))
-      ss.ignore();
-  }
+void amber_sdk::stream_fusion_async(
+    const std::string &sensor_id, const amber_models::PutStreamRequest &request,
+    std::function<void(error_response *, stream_fusion_response &)> callback) {
+
+  // generate sdk request object
+  json j = request;
+  auto sdk_req = sdk_request{"PUT", "stream"};
+  sdk_req.body = j.dump();
+  sdk_req.headers["content-type"] = "application/json";
+  sdk_req.headers["sensorid"] = sensor_id;
+  sdk_req.raw_result = true;
+
+  this->call_api_async<stream_fusion_response>(std::move(sdk_req), callback);
+}
 
-  // compute the number of chunks needed to send all of the pretrain data
-  size_t chunk_size = 1000000;
-  size_t chunk_max = packed_floats.size() / chunk_size;
-  if (packed_floats.size() % chunk_size != 0) {
-    chunk_max++;
+std::future<async_result<stream_fusion_response>>
+amber_sdk::stream_fusion_async(const std::string &sensor_id,
+                               const amber_models::PutStreamRequest &request) {
+  auto promise = make_promise<stream_fusion_response>();
+  this->stream_fusion_async(sensor_id, request, fulfill(promise));
+  return promise->get_future();
+}
+
+/**
+ * Create a prepared streaming handle for a sensor. See sensor_handle.
+ * @param sensor_id: sensor the handle streams to
+ */
+std::unique_ptr<sensor_handle>
+amber_sdk::prepare_sensor(const std::string &sensor_id) {
+  return std::unique_ptr<sensor_handle>(new sensor_handle(this, sensor_id));
+}
+
+sensor_handle::sensor_handle(amber_sdk *amber, std::string sensor_id)
+    : amber(amber), id(std::move(sensor_id)) {
+
+  // bind a dedicated easy handle with every option that never changes,
+  // transport options are applied per request so that they follow the client
+  this->url = amber->license.server + "/stream";
+  this->curl = curl_easy_init();
+  if (this->curl == nullptr) {
+    throw amber_except("failed to create curl handle");
   }
+  curl_easy_setopt(this->curl, CURLOPT_SHARE, amber->share);
+  curl_easy_setopt(this->curl, CURLOPT_URL, this->url.c_str());
+  curl_easy_setopt(this->curl, CURLOPT_POST, 1L);
+  curl_easy_setopt(this->curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+  curl_easy_setopt(this->curl, CURLOPT_WRITEDATA, &this->read_buffer);
+  curl_easy_setopt(this->curl, CURLOPT_ERRORBUFFER, this->error_buffer);
+}
 
-  // send pretrain chunks
-  std::string amber_transaction;
-  for (int chunk_idx = 0; chunk_idx < chunk_max; chunk_idx++) {
+sensor_handle::~sensor_handle() {
+  curl_easy_cleanup(this->curl);
+  curl_slist_free_all(this->hs);
+  curl_slist_free_all(this->hs_encoded);
+}
 
-    // calculate start and end positions
-    size_t start = chunk_idx * chunk_size;
-    size_t end = (chunk_idx + 1) * chunk_size;
-    if (end > packed_floats.size()) {
-      end = packed_floats.size();
-    }
+/**
+ * Rebuild the static header block when the client's token has changed.
+ */
+bool sensor_handle::bind_token(sdk_response &res) {
+  auto current = this->amber->authenticate(res);
+  if (!current) {
+    return false;
+  }
+  if (current == this->token) {
+    return true;
+  }
 
-    // create next packed_float chunk
-    std::vector<float>::const_iterator first =
-        packed_floats.begin() + int(start);
-    std::vector<float>::const_iterator last = packed_floats.begin() + int(end);
-    std::vector<float> chunk(first, last);
+  curl_slist_free_all(this->hs);
+  curl_slist_free_all(this->hs_encoded);
+  this->hs = nullptr;
+  this->hs_encoded = nullptr;
+  this->hs_encoding.clear();
+  auto sensor_header = "sensorid:" + this->id;
+  this->hs = curl_slist_append(this->hs, current->bear_header.c_str());
+  this->hs = curl_slist_append(this->hs, user_agent);
+  this->hs = curl_slist_append(this->hs, "content-type:application/json");
+  this->hs = curl_slist_append(this->hs, sensor_header.c_str());
+  this->token = current;
+  return true;
+}
 
-    std::string encoded_chunk =
-        base64_encode((unsigned char *)chunk.data(), chunk.size() * 4);
-    amber_models::PostPretrainRequest request{encoded_chunk, "packed-float",
-                                              autotuneConfig};
-    json j = request;
-    auto sdk_req = sdk_request{"POST", "pretrain"};
-    sdk_req.body = j.dump();
-    sdk_req.headers["content-type"] = "application/json";
-    sdk_req.headers["sensorid"] = sensor_id;
-    sdk_req.headers["amberchunk"] =
-        std::to_string(chunk_idx + 1) + ":" + std::to_string(chunk_max);
-    if (!amber_transaction.empty()) {
-      sdk_req.headers["ambertransaction"] = amber_transaction;
+/**
+ * The static header block, announcing encoding when the body was compressed.
+ * The list for an encoding is built on first use and kept until the encoding
+ * or the token changes.
+ */
+struct curl_slist *sensor_handle::headers(const char *encoding) {
+  if (encoding == nullptr) {
+    return this->hs;
+  }
+  if (this->hs_encoded == nullptr || this->hs_encoding != encoding) {
+    curl_slist_free_all(this->hs_encoded);
+    this->hs_encoded = nullptr;
+    for (auto h = this->hs; h != nullptr; h = h->next) {
+      this->hs_encoded = curl_slist_append(this->hs_encoded, h->data);
     }
+    auto header = std::string("Content-Encoding: ") + encoding;
+    this->hs_encoded = curl_slist_append(this->hs_encoded, header.c_str());
+    this->hs_encoding = encoding;
+  }
+  return this->hs_encoded;
+}
 
-    // call api and process results
-    sdk_response sdk_res;
-    this->call_api(sdk_req, sdk_res);
-    switch (sdk_res.code) {
-    case 200:
-      if (start != end) {
-        return new error_response(sdk_res.res.get<error_response>());
-      }
-      response = sdk_res.res.get<pretrain_sensor_response>();
-      break;
-    case 202:
-      amber_transaction = sdk_res.headers["ambertransaction"];
-      response = sdk_res.res.get<pretrain_sensor_response>();
-      break;
-    default:
-      return new error_response(sdk_res.res.get<error_response>());
-    }
+/**
+ * Parse a response body into res.res. A body that is not json, such as the
+ * error page of a proxy, becomes an error with the body as its message, so
+ * that no exception escapes to the threads sending requests.
+ */
+static void parse_result(sdk_response &res, const std::string &body) {
+  try {
+    res.res = json::parse(body);
+    return;
+  } catch (json::exception &) {
   }
+  if (res.code == 200) {
+    res.code = 0; // nothing to decode, report it as a failed request
+  }
+  res.res = {{"code", res.code}, {"message", body}};
+}
 
-  while (blocking && response.state == "Pretraining") {
-    sleep(5);
-    get_pretrain_response get_response;
-    auto err = this->get_pretrain(get_response, sensor_id);
-    if (err != nullptr) {
-      return err;
-    }
-    response.amberChunk = "";
-    response.amberTransaction = "";
-    response.message = get_response.message;
-    response.state = get_response.state;
+/**
+ * Send this->body on the bound handle.
+ * @param method: request method other than POST, nullptr for POST
+ */
+void sensor_handle::perform(sdk_response &res, const char *method) {
+  res.code = 0;
+  if (!refuse_expired(res) || !this->bind_token(res)) {
+    return;
+  }
+  this->amber->apply_transport_options(this->curl);
+  this->amber->apply_request_context(this->curl);
+  curl_easy_setopt(this->curl, CURLOPT_CUSTOMREQUEST, method);
+
+  auto encoding = this->amber->compressor.compress(this->body);
+  curl_easy_setopt(this->curl, CURLOPT_HTTPHEADER, this->headers(encoding));
+  curl_easy_setopt(this->curl, CURLOPT_POSTFIELDS, this->body.data());
+  curl_easy_setopt(this->curl, CURLOPT_POSTFIELDSIZE, (long)this->body.size());
+
+  this->read_buffer.clear();
+  this->error_buffer[0] = '\0';
+  auto result = curl_easy_perform(this->curl);
+  this->amber->record_connects(this->curl);
+  if (result != CURLE_OK) {
+    res.code = 0;
+    res.res = {{"code", 0},
+               {"message", transfer_error(result, this->error_buffer)}};
+    return;
   }
+  this->amber->record_upload(&this->amber->compressor, this->curl);
+  long code = 0;
+  curl_easy_getinfo(this->curl, CURLINFO_RESPONSE_CODE, &code);
+  res.code = (int)code;
+  if (res.code != 200) {
+    parse_result(res, this->read_buffer);
+  }
+}
 
-  return nullptr;
+// render the request body directly, no json document needed
+void sensor_handle::render_csv(const std::string &csvdata, bool save_image) {
+  this->body.clear();
+  this->body.append(save_image ? "{\"saveImage\":true,\"data\":"
+                               : "{\"saveImage\":false,\"data\":");
+  append_json_string(this->body, csvdata);
+  this->body.push_back('}');
 }
 
-error_response *amber_sdk::pretrain_sensor(pretrain_sensor_response &response,
+// render float samples into the handle's buffer and send them
+void sensor_handle::perform_floats(const float *data, size_t count,
+                                   bool save_image, sdk_response &res) {
+  auto send = [this](std::string &, sdk_response &res) { this->perform(res); };
+  this->amber->send_float_stream(this->body, data, count, save_image, send,
+                                 res);
+}
+
+error_response *sensor_handle::stream_sensor(stream_sensor_response &response,
+                                             const std::string &csvdata,
+                                             bool save_image) {
+  this->render_csv(csvdata, save_image);
+
+  // call api and process results
+  sdk_response sdk_res;
+  this->perform(sdk_res);
+  if (sdk_res.code != 200) {
+    return new error_response(sdk_res.res.get<error_response>());
+  }
+
+  // decode in place, the buffer keeps its capacity for the next call
+  if (!decode_response(this->read_buffer, response)) {
+    return new error_response{0, "malformed response"};
+  }
+  return nullptr;
+}
+
+error_response *sensor_handle::stream_sensor(stream_sensor_response &response,
+                                             const float *data, size_t count,
+                                             bool save_image) {
+
+  // call api and process results
+  sdk_response sdk_res;
+  this->perform_floats(data, count, save_image, sdk_res);
+  if (sdk_res.code != 200) {
+    return new error_response(sdk_res.res.get<error_response>());
+  }
+  if (!decode_response(this->read_buffer, response)) {
+    return new error_response{0, "malformed response"};
+  }
+  return nullptr;
+}
+
+error_response *sensor_handle::stream_sensor(result_store &store,
+                                             const std::string &csvdata,
+                                             bool save_image) {
+  this->render_csv(csvdata, save_image);
+
+  // call api and append the results in place
+  sdk_response sdk_res;
+  this->perform(sdk_res);
+  if (sdk_res.code != 200) {
+    return new error_response(sdk_res.res.get<error_response>());
+  }
+  if (!decode_response(this->read_buffer, store)) {
+    return new error_response{0, "malformed response"};
+  }
+  return nullptr;
+}
+
+error_response *sensor_handle::stream_sensor(result_store &store,
+                                             const float *data, size_t count,
+                                             bool save_image) {
+
+  // call api and append the results in place
+  sdk_response sdk_res;
+  this->perform_floats(data, count, save_image, sdk_res);
+  if (sdk_res.code != 200) {
+    return new error_response(sdk_res.res.get<error_response>());
+  }
+  if (!decode_response(this->read_buffer, store)) {
+    return new error_response{0, "malformed response"};
+  }
+  return nullptr;
+}
+
+error_response *sensor_handle::stream_fusion(stream_fusion_response &response,
+                                             const fusion_encoder &encoder) {
+
+  // copy into the handle's buffer, compression may replace it in place
+  this->body.assign(encoder.body());
+
+  // call api and process results
+  sdk_response sdk_res;
+  this->perform(sdk_res, "PUT");
+  if (sdk_res.code != 200) {
+    return new error_response(sdk_res.res.get<error_response>());
+  }
+  if (!decode_response(this->read_buffer, response)) {
+    return new error_response{0, "malformed response"};
+  }
+  return nullptr;
+}
+
+error_response *amber_sdk::enable_learning(enable_learning_response &response,
+                                           const std::string &sensor_id,
+                                           uint32_t anomaly_history_window,
+                                           uint64_t learning_rate_numerator,
+                                           uint64_t learning_rate_denominator,
+                                           uint16_t learning_max_clusters,
+                                           uint64_t learning_max_samples) {
+
+  // generate sdk request object
+  amber_models::LearningParameters streaming{
+      learning_rate_numerator, learning_rate_denominator, learning_max_clusters,
+      learning_max_samples};
+  std::vector<amber_models::FusionConfig> fusion_config;
+  amber_models::PutConfigRequest request{fusion_config, streaming};
+  json j = request;
+  j.erase("features");
+  auto sdk_req = sdk_request{"PUT", "config"};
+  sdk_req.body = j.dump();
+  sdk_req.headers["content-type"] = "application/json";
+  sdk_req.headers["sensorid"] = sensor_id;
+
+  // call api and process results
+  sdk_response sdk_res;
+  this->call_api(sdk_req, sdk_res);
+  if (sdk_res.code != 200) {
+    return new error_response(sdk_res.res.get<error_response>());
+  }
+  response = sdk_res.res.get<enable_learning_response>();
+  return nullptr;
+}
+
+error_response *amber_sdk::post_outage(post_outage_response &response,
+                                       const std::string &sensor_id) {
+
+  // generate sdk request object
+  auto sdk_req = sdk_request{"POST", "outage"};
+  sdk_req.headers["content-type"] = "application/json";
+  sdk_req.headers["sensorid"] = sensor_id;
+
+  // call api and process results
+  sdk_response sdk_res;
+  this->call_api(sdk_req, sdk_res);
+  if (sdk_res.code != 200) {
+    return new error_response(sdk_res.res.get<error_response>());
+  }
+  response = sdk_res.res.get<post_outage_response>();
+  return nullptr;
+}
+
+// render a packed-float pretrain request body, reusing the capacity of body
+static void render_pretrain_chunk(std::string &body, const float *data,
+                                   size_t count, bool autotune_config) {
+  body.assign(autotune_config ? "{\"autotuneConfig\":true,\"data\":\""
+                              : "{\"autotuneConfig\":false,\"data\":\"");
+  base64_append(body, (const unsigned char *)data, count * 4);
+  body.append("\",\"format\":\"packed-float\"}");
+}
+
+/**
+ * Send one chunk of an xl pretrain. The body buffer is handed back after the
+ * call so that the next chunk can reuse its capacity.
+ * @param encoding: content encoding already applied to body, or nullptr
+ * @param chunk_idx: zero based index of the chunk
+ */
+error_response *amber_sdk::send_pretrain_chunk(
+    pretrain_sensor_response &response, const std::string &sensor_id,
+    std::string &body, const char *encoding, size_t chunk_idx,
+    size_t chunk_max, std::string &amber_transaction) {
+  auto sdk_req = sdk_request{"POST", "pretrain"};
+  sdk_req.body = std::move(body);
+  sdk_req.content_encoding = encoding;
+  sdk_req.headers["content-type"] = "application/json";
+  sdk_req.headers["sensorid"] = sensor_id;
+  sdk_req.headers["amberchunk"] =
+      std::to_string(chunk_idx + 1) + ":" + std::to_string(chunk_max);
+  if (!amber_transaction.empty()) {
+    sdk_req.headers["ambertransaction"] = amber_transaction;
+  }
+
+  // call api and process results
+  sdk_response sdk_res;
+  this->call_api(sdk_req, sdk_res);
+  body = std::move(sdk_req.body);
+  // every accepted chunk is answered with 202, anything else is an error
+  if (sdk_res.code != 202) {
+    return new error_response(sdk_res.res.get<error_response>());
+  }
+  amber_transaction = sdk_res.headers["ambertransaction"];
+  response = sdk_res.res.get<pretrain_sensor_response>();
+  return nullptr;
+}
+
+// poll the pretrain state until it leaves Pretraining, if blocking
+error_response *amber_sdk::await_pretrain(pretrain_sensor_response &response,
+                                          const std::string &sensor_id,
+                                          bool blocking) {
+  while (blocking && response.state == "Pretraining") {
+    request_context::current().wait(5000);
+    get_pretrain_response get_response;
+    auto err = this->get_pretrain(get_response, sensor_id);
+    if (err != nullptr) {
+      return err;
+    }
+    response.amberChunk = "";
+    response.amberTransaction = "";
+    response.message = get_response.message;
+    response.state = get_response.state;
+  }
+  return nullptr;
+}
+
+/**
+ * Start the progress of an xl pretrain, from the checkpoint saved at path if
+ * there is one for the same upload.
+ */
+static error_response *open_checkpoint(pretrain_checkpoint &progress,
+                                       const std::string &path,
+                                       const std::string &sensor_id,
+                                       uint64_t input_size, uint64_t total) {
+  if (path.empty() || !progress.load(path)) {
+    if (!progress.error().empty()) {
+      return new error_response{0, progress.error()};
+    }
+    progress.reset(sensor_id, input_size, total);
+    return nullptr;
+  }
+  if (!progress.matches(sensor_id, input_size, total)) {
+    return new error_response{
+        0, "pretrain checkpoint " + path + " is for a different upload"};
+  }
+  return nullptr;
+}
+
+/**
+ * Upload the chunks of an xl pretrain that progress does not have as
+ * accepted yet. Chunks an earlier attempt encoded keep their extent, the
+ * rest are sized by pretrain_chunks as they are encoded. A separate thread
+ * encodes and compresses chunks ahead of the upload, so the cpu work for
+ * chunk k+1 overlaps the transfer of chunk k. After the first chunk has
+ * opened the transaction, up to pretraining.in_flight chunks are sent at
+ * once. The response of the last chunk is returned.
+ * @param encode: renders a chunk's request body, in chunk order
+ * @param progress: chunks accepted so far, updated as more are
+ * @param checkpoint: file progress is saved to after every accepted chunk,
+ * none if empty
+ */
+error_response *amber_sdk::upload_pretrain(pretrain_sensor_response &response,
+                                           const std::string &sensor_id,
+                                           const chunk_encoder &encode,
+                                           pretrain_checkpoint &progress,
+                                           const std::string &checkpoint) {
+  class chunk {
+  public:
+    size_t idx;
+    size_t count; // chunk count announced with it
+    size_t samples;
+    std::string body;
+    const char *encoding;
+  };
+
+  size_t senders = std::max<size_t>(1, this->pretraining.in_flight);
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<chunk> ready;              // encoded chunks, in order
+  std::vector<std::string> spare(senders + 1); // bodies free for encoding
+  std::string amber_transaction = progress.transaction;
+  bool opened = !progress.acked.empty() && progress.acked[0];
+  bool encoded_all = false; // every missing chunk is in ready or sent
+  bool sent_last = false;   // the last chunk was accepted in this call
+  uint64_t total = progress.total_samples;
+  uint64_t covered = progress.covered_samples();
+  size_t sending = 0; // chunks in flight
+  error_response *failed = nullptr;
+  this->pretrain_chunks.begin_upload(senders);
+
+  auto encoder = [&] {
+    for (size_t idx = 0;; idx++) {
+      chunk_extent extent{};
+      size_t count;
+      std::string body;
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        bool known = idx < progress.chunks.size();
+        if (known && progress.acked[idx]) {
+          continue;
+        }
+        if (!known && covered == total) {
+          encoded_all = true;
+          cv.notify_all();
+          return;
+        }
+        cv.wait(guard, [&] { return !spare.empty() || failed != nullptr; });
+        if (failed != nullptr) {
+          return;
+        }
+        // stop encoding once the caller's deadline passed or it cancelled,
+        // the senders then give up on the chunks still waiting
+        auto reason = request_context::current().refusal();
+        if (reason != nullptr) {
+          failed = new error_response{0, reason};
+          cv.notify_all();
+          return;
+        }
+        body = std::move(spare.back());
+        spare.pop_back();
+
+        // chunks still to be cut are counted at the size planned now, which
+        // a resumed upload may have changed
+        size_t size;
+        if (known) {
+          extent = progress.chunks[idx];
+          size = this->pretrain_chunks.peek_size();
+        } else {
+          size = this->pretrain_chunks.next_size();
+          extent.begin =
+              progress.chunks.empty() ? 0 : progress.chunks.back().end;
+          extent.samples = std::min<uint64_t>(size, total - covered);
+        }
+        uint64_t after = known ? covered : covered + extent.samples;
+        count = std::max(progress.chunks.size(), idx + 1) +
+                (total - after + size - 1) / size;
+      }
+
+      auto err = encode(body, extent);
+      auto encoding =
+          err == nullptr ? this->pretrain_compressor.compress(body) : nullptr;
+      std::lock_guard<std::mutex> guard(lock);
+      if (err != nullptr) {
+        if (failed == nullptr) {
+          failed = err;
+        } else {
+          delete err;
+        }
+        cv.notify_all();
+        return;
+      }
+      if (idx == progress.chunks.size()) {
+        progress.add_chunk(extent);
+        covered += extent.samples;
+      }
+      ready.push_back(chunk{idx, count, (size_t)extent.samples,
+                            std::move(body), encoding});
+      cv.notify_all();
+    }
+  };
+
+  auto sender = [&] {
+    while (true) {
+      chunk c;
+      std::string transaction;
+      size_t shared;
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        cv.wait(guard, [&] {
+          return failed != nullptr || (encoded_all && ready.empty()) ||
+                 (!ready.empty() && (ready.front().idx == 0 || opened));
+        });
+        if (failed != nullptr || ready.empty()) {
+          return;
+        }
+        c = std::move(ready.front());
+        ready.pop_front();
+        transaction = amber_transaction;
+        shared = ++sending;
+      }
+
+      pretrain_sensor_response chunk_response;
+      auto start = std::chrono::steady_clock::now();
+      auto err = this->send_pretrain_chunk(
+          chunk_response, sensor_id, c.body, c.encoding, c.idx, c.count,
+          transaction);
+      std::chrono::duration<double> took =
+          std::chrono::steady_clock::now() - start;
+
+      // the chunk shared the link with those in flight when it started or,
+      // if more, when it finished
+      std::lock_guard<std::mutex> guard(lock);
+      shared = std::max(shared, sending--);
+      if (err == nullptr) {
+        this->pretrain_chunks.record(c.samples, c.body.size(), took.count(),
+                                     shared);
+        if (c.idx == 0) {
+          amber_transaction = transaction;
+          progress.transaction = transaction;
+          opened = true;
+        }
+        if (c.idx + 1 == c.count) {
+          response = chunk_response;
+          sent_last = true;
+        }
+        progress.acked[c.idx] = true;
+        if (!checkpoint.empty() && !progress.save(checkpoint)) {
+          err = new error_response{0, progress.error()};
+        }
+      }
+      if (err != nullptr) {
+        if (failed == nullptr) {
+          failed = err;
+        } else {
+          delete err;
+        }
+      }
+      spare.push_back(std::move(c.body));
+      cv.notify_all();
+    }
+  };
+
+  // extra senders and the encoder run under the caller's deadline and token
+  auto context = request_context::current();
+  auto bounded = [context](const std::function<void()> &run) {
+    if (context.has_deadline()) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          context.deadline - std::chrono::steady_clock::now());
+      request_scope scope(std::max(left, std::chrono::milliseconds(0)),
+                          context.cancel);
+      run();
+    } else {
+      request_scope scope(context.cancel);
+      run();
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.emplace_back(bounded, encoder);
+  for (size_t i = 1; i < senders; i++) {
+    threads.emplace_back(bounded, sender);
+  }
+  sender();
+  for (auto &t : threads) {
+    t.join();
+  }
+  if (failed != nullptr) {
+    return failed;
+  }
+
+  // the last chunk was accepted by an earlier attempt, ask for the state
+  if (total > 0 && !sent_last) {
+    get_pretrain_response get_response;
+    auto err = this->get_pretrain(get_response, sensor_id);
+    if (err != nullptr) {
+      return err;
+    }
+    response.message = get_response.message;
+    response.state = get_response.state;
+  }
+  return nullptr;
+}
+
+/**
+ * Pretrain with csv data too large for one request, sent in chunks of
+ * packed floats sized as set_pretrain_chunking says.
+ * @param checkpoint: file recording which chunks the server accepted, none if
+ * empty. If the upload fails partway, calling again with the same data and
+ * checkpoint sends only the chunks still missing within the same
+ * transaction. The file is deleted once the pretrain has been uploaded and,
+ * if blocking, has finished.
+ */
+error_response *
+amber_sdk::pretrain_sensor_xl(pretrain_sensor_response &response,
+                              const std::string &sensor_id, std::string csvdata,
+                              bool autotuneConfig, bool blocking,
+                              const std::string &checkpoint) {
+
+  // parse csv data into float vector
+  std::vector<float> packed_floats;
+  size_t bad = 0;
+  if (!parse_csv_floats(csvdata, packed_floats, 0, &bad)) {
+    return new error_response{
+        0, "invalid csv value at offset " + std::to_string(bad)};
+  }
+
+  pretrain_checkpoint progress;
+  auto err = open_checkpoint(progress, checkpoint, sensor_id, csvdata.size(),
+                             packed_floats.size());
+  if (err != nullptr) {
+    return err;
+  }
+
+  // send pretrain chunks, encoded straight from the parsed samples
+  auto encode = [&](std::string &body,
+                    chunk_extent &extent) -> error_response * {
+    render_pretrain_chunk(body, packed_floats.data() + extent.begin,
+                          extent.samples, autotuneConfig);
+    extent.end = extent.begin + extent.samples;
+    return nullptr;
+  };
+  err = this->upload_pretrain(response, sensor_id, encode, progress,
+                              checkpoint);
+  if (err != nullptr) {
+    return err;
+  }
+
+  err = this->await_pretrain(response, sensor_id, blocking);
+  if (err == nullptr && !checkpoint.empty()) {
+    pretrain_checkpoint::remove(checkpoint);
+  }
+  return err;
+}
+
+/**
+ * Pretrain from a file without loading it. The file is memory mapped and
+ * every chunk is parsed, encoded and compressed into buffers reused from one
+ * chunk to the next, which curl sends as they are (see upload_pretrain).
+ * Pages of the file are released once their chunk is encoded, so memory use
+ * follows the chunk size rather than the size of the file.
+ * @param path: file holding the pretrain data
+ * @param format: csv text or raw little endian float32 samples
+ * @param checkpoint: file recording which chunks the server accepted, see
+ * pretrain_sensor_xl. Chunks are resumed at the file offsets it records, so
+ * a csv file is not parsed again up to the first missing chunk.
+ */
+error_response *amber_sdk::pretrain_sensor_xl_file(
+    pretrain_sensor_response &response, const std::string &sensor_id,
+    const std::string &path, pretrain_file_format format, bool autotuneConfig,
+    bool blocking, const std::string &checkpoint) {
+
+  mapped_file file;
+  if (!file.open(path)) {
+    return new error_response{0, file.error()};
+  }
+  const char *end = file.data() + file.size();
+
+  // the chunk count goes out with the first chunk, so count the samples
+  // first, a window at a time so the pages counted can be released again
+  size_t total = 0;
+  if (format == pretrain_file_format::csv) {
+    const size_t window = 16 << 20;
+    for (const char *at = file.data(); at < end;) {
+      const char *stop = at + std::min<size_t>(window, end - at);
+      while (stop < end && !is_csv_separator(*stop)) {
+        stop++;
+      }
+      total += count_csv_values(at, stop - at);
+      file.release(at - file.data(), stop - at);
+      at = stop;
+    }
+  } else if (file.size() % sizeof(float) != 0) {
+    return new error_response{0, path + " is not a whole number of float32"};
+  } else {
+    total = file.size() / sizeof(float);
+  }
+  pretrain_checkpoint progress;
+  auto err =
+      open_checkpoint(progress, checkpoint, sensor_id, file.size(), total);
+  if (err != nullptr) {
+    return err;
+  }
+
+  // csv is parsed into a chunk sized buffer on the encoding thread, float32
+  // is encoded in place
+  std::vector<float> samples;
+  auto encode = [&](std::string &body,
+                    chunk_extent &extent) -> error_response * {
+    const char *first = file.data() + extent.begin;
+    const char *p = first;
+    const float *data;
+    if (format == pretrain_file_format::csv) {
+      samples.resize(std::max<size_t>(samples.size(), extent.samples));
+      size_t count;
+      if (!parse_csv_values(p, end, samples.data(), extent.samples, count)) {
+        return new error_response{0, "invalid csv value at offset " +
+                                         std::to_string(p - file.data())};
+      }
+      if (count != extent.samples) {
+        return new error_response{0, path + " changed during the upload"};
+      }
+      data = samples.data();
+    } else {
+      data = (const float *)first;
+      p += extent.samples * sizeof(float);
+    }
+    render_pretrain_chunk(body, data, extent.samples, autotuneConfig);
+    file.release(first - file.data(), p - first);
+    extent.end = p - file.data();
+    return nullptr;
+  };
+  err = this->upload_pretrain(response, sensor_id, encode, progress,
+                              checkpoint);
+  if (err != nullptr) {
+    return err;
+  }
+
+  err = this->await_pretrain(response, sensor_id, blocking);
+  if (err == nullptr && !checkpoint.empty()) {
+    pretrain_checkpoint::remove(checkpoint);
+  }
+  return err;
+}
+
+error_response *amber_sdk::pretrain_sensor(pretrain_sensor_response &response,
                                            const std::string &sensor_id,
                                            std::string csvdata,
                                            bool autotuneConfig, bool blocking) {
@@ -515,7 +1582,7 @@ error_response *amber_sdk::pretrain_sensor(pretrain_sensor_response &response,
     get_pretrain_response get_response;
     get_response.state = "Pretraining";
     while (blocking && get_response.state == "Pretraining") {
-      sleep(5);
+      request_context::current().wait(5000);
       auto err = this->get_pretrain(get_response, sensor_id);
       if (err != nullptr) {
         return err;
@@ -587,6 +1654,7 @@ error_response *amber_sdk::get_status(get_status_response &response,
   auto sdk_req = sdk_request{"GET", "status"};
   sdk_req.headers["content-type"] = "application/json";
   sdk_req.headers["sensorid"] = sensor_id;
+  sdk_req.raw_result = true;
 
   // call api and process results
   sdk_response sdk_res;
@@ -594,8 +1662,27 @@ error_response *amber_sdk::get_status(get_status_response &response,
   if (sdk_res.code != 200) {
     return new error_response(sdk_res.res.get<error_response>());
   }
-  response = sdk_res.res.get<get_status_response>();
-  return nullptr;
+  return decode_result(sdk_res, response);
+}
+
+void amber_sdk::get_status_async(
+    const std::string &sensor_id,
+    std::function<void(error_response *, get_status_response &)> callback) {
+
+  // generate sdk request object
+  auto sdk_req = sdk_request{"GET", "status"};
+  sdk_req.headers["content-type"] = "application/json";
+  sdk_req.headers["sensorid"] = sensor_id;
+  sdk_req.raw_result = true;
+
+  this->call_api_async<get_status_response>(std::move(sdk_req), callback);
+}
+
+std::future<async_result<get_status_response>>
+amber_sdk::get_status_async(const std::string &sensor_id) {
+  auto promise = make_promise<get_status_response>();
+  this->get_status_async(sensor_id, fulfill(promise));
+  return promise->get_future();
 }
 
 error_response *
@@ -641,47 +1728,222 @@ error_response *amber_sdk::get_root_cause_by_patternlist(
 
 void amber_sdk::call_api(sdk_request &req, sdk_response &res, bool is_auth) {
 
-  // set up curl request
-  CURL *curl;
-  curl = curl_easy_init();
-  struct curl_slist *hs = nullptr;
-  std::string url;
+  sdk_transfer t;
+  t.req = std::move(req);
+  if (!this->prepare_transfer(t, res, is_auth)) {
+    req.body = std::move(t.req.body);
+    return;
+  }
+
+  // send request and process result
+  auto start = std::chrono::steady_clock::now();
+  long delay_ms = is_auth ? -1 : this->hedge_delay(t.req);
+  if (delay_ms >= 0) {
+    this->perform_hedged(t, delay_ms, res);
+  } else {
+    auto curl_result = curl_easy_perform(t.curl);
+    this->finish_transfer(t, curl_result, res);
+  }
+  if (res.code == 200 && !is_auth) {
+    this->latency.record(t.req.slug,
+                         std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count());
+  }
+
+  // hand the body buffer back so that callers can reuse its capacity
+  req.body = std::move(t.req.body);
+}
+
+/**
+ * Send a duplicate of slow GET requests. The duplicate goes out once a GET
+ * has been running for longer than the configured percentile of its
+ * endpoint's recent latency, and whichever response arrives first is used.
+ * @param enable: hedge GET requests
+ * @param percentile: latency percentile (0 to 1) after which to hedge
+ * @param min_delay_ms: never hedge sooner than this
+ */
+void amber_sdk::set_hedging(bool enable, double percentile,
+                            long min_delay_ms) {
+  if (percentile <= 0 || percentile > 1) {
+    throw amber_except("invalid hedging percentile %f", percentile);
+  }
+  this->hedging.enabled = enable;
+  this->hedging.percentile = percentile;
+  this->hedging.min_delay_ms = min_delay_ms;
+}
+
+hedge_stats amber_sdk::get_hedge_stats() {
+  return hedge_stats{this->stat_hedged.load(), this->stat_hedge_wins.load()};
+}
+
+// delay after which req is hedged, -1 when it is not. a slug needs some
+// history before its percentile means anything.
+long amber_sdk::hedge_delay(const sdk_request &req) {
+  if (!this->hedging.enabled || req.operation != "GET") {
+    return -1;
+  }
+  double ms = this->latency.percentile(req.slug, this->hedging.percentile, 20);
+  if (ms < 0) {
+    return -1;
+  }
+  return std::max(this->hedging.min_delay_ms, (long)ms);
+}
+
+/**
+ * Perform the prepared transfer t on a private multi handle, adding a
+ * duplicate if it has not completed after delay_ms. The first successful
+ * transfer is decoded into res and the other one is cancelled.
+ */
+void amber_sdk::perform_hedged(sdk_transfer &t, long delay_ms,
+                               sdk_response &res) {
+  CURLM *multi = curl_multi_init();
+  if (multi == nullptr) {
+    this->finish_transfer(t, curl_easy_perform(t.curl), res);
+    return;
+  }
+  curl_multi_add_handle(multi, t.curl);
+
+  std::unique_ptr<sdk_transfer> hedge;
+  sdk_transfer *winner = nullptr;
+  sdk_transfer *failed = nullptr;
+  CURLcode winner_result = CURLE_OK;
+  CURLcode failed_result = CURLE_OK;
+  int active = 1;
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms);
+
+  while (winner == nullptr && active > 0) {
+    int running = 0;
+    curl_multi_perform(multi, &running);
+
+    CURLMsg *msg;
+    int queued;
+    while (winner == nullptr &&
+           (msg = curl_multi_info_read(multi, &queued)) != nullptr) {
+      if (msg->msg != CURLMSG_DONE) {
+        continue;
+      }
+      auto done = msg->easy_handle == t.curl ? &t : hedge.get();
+      auto result = msg->data.result;
+      curl_multi_remove_handle(multi, done->curl);
+      active--;
+      if (result == CURLE_OK) {
+        winner = done;
+        winner_result = CURLE_OK;
+      } else {
+        // a transport failure only counts if the other transfer fails too
+        failed = done;
+        failed_result = result;
+      }
+    }
+    if (winner != nullptr || active == 0) {
+      break;
+    }
+
+    // send the duplicate once the original is overdue
+    auto now = std::chrono::steady_clock::now();
+    if (!hedge && failed == nullptr && now >= deadline) {
+      hedge.reset(new sdk_transfer);
+      hedge->req = t.req;
+      sdk_response ignored;
+      if (this->prepare_transfer(*hedge, ignored, false)) {
+        curl_multi_add_handle(multi, hedge->curl);
+        active++;
+        this->stat_hedged++;
+      }
+    }
+    int timeout_ms = 1000;
+    if (!hedge) {
+      timeout_ms = (int)std::max<long>(
+          1, std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+                                                                   now)
+                     .count());
+    }
+    curl_multi_poll(multi, nullptr, 0, timeout_ms, nullptr);
+  }
+
+  if (winner == nullptr) {
+    winner = failed;
+    winner_result = failed_result;
+    failed = nullptr;
+  }
+  if (winner == hedge.get()) {
+    this->stat_hedge_wins++;
+  }
+
+  // cancel the transfer still running, then return both handles to the pool
+  sdk_response discarded;
+  for (auto other : {&t, hedge.get()}) {
+    if (other == nullptr || other == winner || other->curl == nullptr) {
+      continue;
+    }
+    if (other != failed) {
+      curl_multi_remove_handle(multi, other->curl);
+    }
+    this->finish_transfer(*other, CURLE_ABORTED_BY_CALLBACK, discarded);
+  }
+  curl_multi_cleanup(multi);
+  this->finish_transfer(*winner, winner_result, res);
+}
+
+/**
+ * Build a pooled easy handle for the request held by the transfer. Returns
+ * false when the client could not authenticate, in which case res holds the
+ * failed authentication result.
+ */
+bool amber_sdk::prepare_transfer(sdk_transfer &t, sdk_response &res,
+                                 bool is_auth) {
 
+  sdk_request &req = t.req;
   res.code = 0;
 
+  // refuse at once once the caller's deadline passed or it cancelled
+  if (!refuse_expired(res)) {
+    res.unsent = true;
+    return false;
+  }
+
   // authenticate
   if (is_auth) {
     // this call is performing authentication so access oauth server
-    url = this->license.oauth_server + '/' + req.slug + req.query_params;
+    t.url = this->license.oauth_server + '/' + req.slug + req.query_params;
   } else {
-    if (!this->authenticate(res)) {
-      curl_easy_cleanup(curl);
-      return;
+    auto token = this->authenticate(res);
+    if (!token) {
+      res.unsent = true;
+      return false;
     }
-    url = this->license.server + '/' + req.slug + req.query_params;
-    hs = curl_slist_append(hs, this->auth_bear_header.c_str());
+    t.url = this->license.server + '/' + req.slug + req.query_params;
+    t.hs = curl_slist_append(t.hs, token->bear_header.c_str());
   }
+  CURL *curl = this->acquire_handle();
+  t.curl = curl;
 
   // apply user_agent to identify the sdk in requests
-  hs = curl_slist_append(hs, user_agent);
+  t.hs = curl_slist_append(t.hs, user_agent);
 
   // apply specified http headers
   for (auto &iter : req.headers) {
     auto header = iter.first + ':' + iter.second;
-    hs = curl_slist_append(hs, header.c_str());
+    t.hs = curl_slist_append(t.hs, header.c_str());
   }
 
   // apply operation
-  if (req.operation == "POST") {
-    if (req.body.size() > 10000) {
-      req.body = compress_string(req.body);
-      hs = curl_slist_append(hs, "Content-Encoding: gzip");
+  if (req.operation == "POST" || req.operation == "PUT") {
+    t.compressor = &this->compressor_for(req);
+    auto encoding = req.content_encoding != nullptr
+                        ? req.content_encoding
+                        : t.compressor->compress(req.body);
+    if (encoding != nullptr) {
+      t.hs = curl_slist_append(
+          t.hs, (std::string("Content-Encoding: ") + encoding).c_str());
+    }
+    if (req.operation == "PUT") {
+      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
     }
     curl_easy_setopt(curl, CURLOPT_POSTFIELDS, req.body.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, req.body.size());
-  } else if (req.operation == "PUT") {
-    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, req.body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)req.body.size());
   } else if (req.operation == "GET") {
     curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
   } else if (req.operation == "DELETE") {
@@ -690,17 +1952,45 @@ void amber_sdk::call_api(sdk_request &req, sdk_response &res, bool is_auth) {
     // bad operation
   }
 
-  std::string read_buffer;   // response body
-  std::string header_buffer; // response headers
-  char error_buffer[CURL_ERROR_SIZE];
-  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, hs);
+  curl_easy_setopt(curl, CURLOPT_URL, t.url.c_str());
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, t.hs);
   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &read_buffer);
-  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error_buffer);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &t.read_buffer);
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, t.error_buffer);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &t.header_buffer);
+  this->apply_transport_options(curl);
+  this->apply_request_context(curl);
+  return true;
+}
+
+/**
+ * Bound a transfer by the client's request timeout and the calling thread's
+ * request_scope, and let its cancel token abort the transfer.
+ */
+void amber_sdk::apply_request_context(CURL *curl) {
+  auto &context = request_context::current();
+  long timeout_ms = this->conn.request_timeout_ms;
+  if (context.has_deadline()) {
+    long left = context.remaining_ms();
+    timeout_ms = timeout_ms > 0 ? std::min(timeout_ms, left) : left;
+  }
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+  if (context.cancel != nullptr) {
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, cancel_progress);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, context.cancel);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+  } else {
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
+  }
+}
+
+/**
+ * Apply the client's tls, connection reuse and protocol options to an easy
+ * handle.
+ */
+void amber_sdk::apply_transport_options(CURL *curl) {
   curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, this->ssl.verify ? 1 : 0);
   curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, this->ssl.verify ? 1 : 0);
-  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &header_buffer);
   if (this->ssl.verify) {
     if (!this->ssl.cert.empty()) {
       curl_easy_setopt(curl, CURLOPT_SSLCERT, this->ssl.cert.c_str());
@@ -710,125 +2000,337 @@ void amber_sdk::call_api(sdk_request &req, sdk_response &res, bool is_auth) {
     }
   }
 
-  // send request and process result
-  auto curl_result = curl_easy_perform(curl);
-  if (curl_result == CURLE_OK) {
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &res.code);
-    res.headers = parse_headers(header_buffer);
-    res.res = json::parse(read_buffer);
+  // keep connections open between requests and resume tls sessions
+  curl_easy_setopt(curl, CURLOPT_MAXCONNECTS, (long)this->conn.pool_size);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, this->conn.keepalive_idle);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, this->conn.keepalive_interval);
+  curl_easy_setopt(curl, CURLOPT_SSL_SESSIONID_CACHE, 1L);
+  if (this->conn.connect_timeout_ms > 0) {
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS,
+                     this->conn.connect_timeout_ms);
+  }
+
+  // http/2 requests wait for a multiplexable connection rather than opening
+  // a new one, and header compression shrinks the repeated auth headers
+  switch (this->conn.version) {
+  case http_version::http2:
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    break;
+  case http_version::http2_prior_knowledge:
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION,
+                     CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    break;
+  case http_version::http1_1:
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+    break;
+  default:
+    break;
+  }
+
+  // advertise every encoding libcurl can decode (gzip and deflate at least).
+  // compressed responses are inflated chunk by chunk as they arrive, so the
+  // write callback and the response decoders only ever see plain json.
+  if (this->conn.accept_encoding) {
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
   }
-  curl_easy_cleanup(curl);
-  curl_slist_free_all(hs);
 }
 
 /**
- * Authenticate client for the next hour using the credentials given at
-  initialization. This acquires and stores an oauth2 token which remains
-  valid for one hour and is used to authenticate all other API requests.
- * @return
+ * Return the transfer's easy handle to the pool and decode the response.
+ * Transport failures are reported with code 0 and the curl error message.
  */
-bool amber_sdk::authenticate(sdk_response &res) {
+void amber_sdk::finish_transfer(sdk_transfer &t, CURLcode result,
+                                sdk_response &res) {
+  long code = 0;
+  long version = 0;
+  double pretransfer = 0;
+  if (result == CURLE_OK) {
+    curl_easy_getinfo(t.curl, CURLINFO_RESPONSE_CODE, &code);
+    curl_easy_getinfo(t.curl, CURLINFO_HTTP_VERSION, &version);
+  } else {
+    curl_easy_getinfo(t.curl, CURLINFO_PRETRANSFER_TIME, &pretransfer);
+  }
+  this->record_connects(t.curl);
+  if (t.compressor != nullptr && result == CURLE_OK) {
+    this->record_upload(t.compressor, t.curl);
+  }
+  this->release_handle(t.curl);
+  t.curl = nullptr;
+  curl_slist_free_all(t.hs);
+  t.hs = nullptr;
+
+  if (result != CURLE_OK) {
+    res.code = 0;
+    res.res = {{"code", 0},
+               {"message", transfer_error(result, t.error_buffer)}};
+    res.unsent = result == CURLE_COULDNT_RESOLVE_HOST ||
+                 result == CURLE_COULDNT_RESOLVE_PROXY ||
+                 result == CURLE_COULDNT_CONNECT || pretransfer == 0;
+    return;
+  }
+  res.code = (int)code;
+  res.headers = parse_headers(t.header_buffer);
+
+  // only http/2 requests that wait for a shared connection are guaranteed to
+  // go out on the same one, in the order they were issued
+  res.multiplexed = version >= CURL_HTTP_VERSION_2_0 &&
+                    (this->conn.version == http_version::http2 ||
+                     this->conn.version == http_version::http2_prior_knowledge);
+  if (res.code == 200 && t.req.raw_result) {
+    res.body = std::move(t.read_buffer);
+    return;
+  }
+  parse_result(res, t.read_buffer);
+}
 
-  if (this->auth_ok &&
-      std::time(nullptr) + this->expires_in - 100 < this->auth_time) {
-    // auth token is still good
-    res.code = 200;
-    return true;
+request_engine *amber_sdk::get_engine() {
+  std::lock_guard<std::mutex> guard(this->engine_lock);
+  if (!this->engine) {
+    this->engine.reset(new request_engine(this->conn.max_host_connections));
   }
-  this->auth_ok = false;
+  return this->engine.get();
+}
 
-  // create request body
-  auto request = amber_models::PostAuth2Request{this->license.username,
-                                                this->license.password};
+size_t amber_sdk::async_in_flight() {
+  std::lock_guard<std::mutex> guard(this->engine_lock);
+  return this->engine ? this->engine->in_flight() : 0;
+}
 
-  // generate sdk request object
-  json j = request;
-  auto sdk_req = sdk_request{"POST", "oauth2"};
-  sdk_req.body = j.dump();
-  sdk_req.headers["content-type"] = "application/json";
+/**
+ * Issue a request on the event loop. done runs on the engine thread with the
+ * response, or at once on the calling thread when the request cannot be
+ * sent; transport failures arrive with code 0.
+ */
+void amber_sdk::submit_async(sdk_request req,
+                             std::function<void(sdk_response &)> done) {
 
-  // call api with auth disabled (since this is the oauth2 call itself)
+  auto t = std::make_shared<sdk_transfer>();
+  t->req = std::move(req);
   sdk_response sdk_res;
-  this->call_api(sdk_req, sdk_res, true);
-  if (sdk_res.code != 200) {
-    this->auth_ok = false;
-    return false;
+  if (!this->prepare_transfer(*t, sdk_res, false)) {
+    done(sdk_res);
+    return;
   }
 
-  // process response and stash token
-  this->auth = sdk_res.res;
-  this->auth_ok = true;
-  this->expires_in = std::stoul(this->auth.expiresIn, nullptr, 0);
-  this->auth_time = std::time(nullptr) + this->expires_in;
-  this->auth_bear_header =
-      std::string("Authorization: Bearer " + this->auth.idToken);
-  return true;
+  this->get_engine()->submit(t->curl, [this, t, done](CURLcode result) {
+    sdk_response sdk_res;
+    try {
+      this->finish_transfer(*t, result, sdk_res);
+    } catch (json::exception &e) {
+      sdk_res.code = 0;
+      sdk_res.res = {{"code", 0}, {"message", e.what()}};
+    }
+    done(sdk_res);
+  });
 }
 
-std::string compress_string(const std::string &str) {
-  z_stream zs;
-  memset(&zs, 0, sizeof(zs));
+/**
+ * Issue a request on the event loop and decode the response into T. The
+ * callback runs on the engine thread and takes ownership of err, exactly as
+ * the synchronous endpoints hand their error to the caller. An exception
+ * thrown by the callback is dropped.
+ */
+template <typename T>
+void amber_sdk::call_api_async(
+    sdk_request req, std::function<void(error_response *, T &)> callback) {
+  this->submit_async(std::move(req), [callback](sdk_response &sdk_res) {
+    T response{};
+    error_response *err = nullptr;
+    try {
+      if (sdk_res.code != 200) {
+        err = new error_response(sdk_res.res.get<error_response>());
+      } else {
+        err = decode_result(sdk_res, response);
+      }
+    } catch (json::exception &e) {
+      err = new error_response{0, e.what()};
+    }
+    callback(err, response);
+  });
+}
 
-  // gzip init
-  if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 | 16, 8,
-                   Z_DEFAULT_STRATEGY) != Z_OK) {
-    throw(std::runtime_error("deflateInit failed while compressing."));
+// a token is replaced 100 seconds before expiry, or after three quarters of
+// its lifetime for short lived tokens
+static bool token_valid(const std::shared_ptr<const auth_token> &t) {
+  if (!t) {
+    return false;
   }
+  auto margin = std::min<std::time_t>(100, (t->expires_at - t->issued_at) / 4);
+  return std::time(nullptr) + margin < t->expires_at;
+}
 
-  zs.next_in = (Bytef *)str.data();
-  zs.avail_in = str.size(); // set the z_stream's input
+/**
+ * Authenticate client for the next hour using the credentials given at
+  initialization. This acquires and stores an oauth2 token which remains
+  valid for one hour and is used to authenticate all other API requests.
+  Concurrent callers finding an expired token wait for a single refresh,
+  no longer than the calling thread's request_scope allows.
+ * @return the current token, or nullptr with the failed response in res
+ */
+std::shared_ptr<const auth_token> amber_sdk::authenticate(sdk_response &res) {
 
-  int ret;
-  char outbuffer[32768];
-  std::string outstring;
+  auto current = std::atomic_load(&this->token);
+  if (token_valid(current)) {
+    // auth token is still good
+    res.code = 200;
+    return current;
+  }
 
-  // retrieve the compressed bytes blockwise
-  do {
-    zs.next_out = reinterpret_cast<Bytef *>(outbuffer);
-    zs.avail_out = sizeof(outbuffer);
+  // wait for a refresh in progress elsewhere within the scope's bounds,
+  // looking at the cancel token every 50 ms
+  auto &context = request_context::current();
+  std::unique_lock<std::timed_mutex> guard(this->auth_lock, std::defer_lock);
+  if (!context.has_deadline() && context.cancel == nullptr) {
+    guard.lock();
+  }
+  while (!guard.owns_lock()) {
+    auto reason = context.refusal();
+    if (reason != nullptr) {
+      res.code = 0;
+      res.res = {{"code", 0}, {"message", reason}};
+      return nullptr;
+    }
+    guard.try_lock_until(
+        std::min(context.deadline, std::chrono::steady_clock::now() +
+                                       std::chrono::milliseconds(50)));
+  }
+  current = std::atomic_load(&this->token);
+  if (token_valid(current)) {
+    // another thread refreshed the token while we waited
+    res.code = 200;
+    return current;
+  }
+  return this->request_token(res, false);
+}
 
-    ret = deflate(&zs, Z_FINISH);
+/**
+ * Acquire a new token from the oauth2 server and publish it. When use_refresh
+ * is set the refresh token of the current snapshot is tried first, falling
+ * back to the account credentials if the server rejects it. The caller must
+ * hold auth_lock.
+ * @return the new token, or nullptr with the failed response in res
+ */
+std::shared_ptr<const auth_token> amber_sdk::request_token(sdk_response &res,
+                                                           bool use_refresh) {
 
-    if (outstring.size() < zs.total_out) {
-      // append the block to the output string
-      outstring.append(outbuffer, zs.total_out - outstring.size());
-    }
-  } while (ret == Z_OK);
+  auto current = std::atomic_load(&this->token);
+  sdk_response sdk_res;
+  if (use_refresh && current && !current->refresh_token.empty()) {
+    json j = amber_models::PostAuth2RefreshRequest{current->refresh_token};
+    auto sdk_req = sdk_request{"POST", "oauth2"};
+    sdk_req.body = j.dump();
+    sdk_req.headers["content-type"] = "application/json";
+    this->call_api(sdk_req, sdk_res, true);
+  }
 
-  deflateEnd(&zs);
+  if (sdk_res.code != 200) {
+    // create request body
+    auto request = amber_models::PostAuth2Request{this->license.username,
+                                                  this->license.password};
+
+    // generate sdk request object
+    json j = request;
+    auto sdk_req = sdk_request{"POST", "oauth2"};
+    sdk_req.body = j.dump();
+    sdk_req.headers["content-type"] = "application/json";
+
+    // call api with auth disabled (since this is the oauth2 call itself)
+    this->call_api(sdk_req, sdk_res, true);
+    if (sdk_res.code != 200) {
+      res = sdk_res;
+      return nullptr;
+    }
+  }
 
-  if (ret != Z_STREAM_END) { // an error occurred that was not EOF
-    std::ostringstream oss;
-    oss << "Exception during zlib compression: (" << ret << ") " << zs.msg;
-    throw(std::runtime_error(oss.str()));
+  // process response and publish the new token
+  amber_models::PostAuth2Response auth;
+  unsigned long expires_in;
+  try {
+    auth = sdk_res.res;
+    expires_in = std::stoul(auth.expiresIn, nullptr, 0);
+  } catch (std::exception &e) {
+    // a 200 without a usable token is reported as a failed request
+    res.code = 0;
+    res.res = {{"code", 0},
+               {"message", std::string("malformed oauth2 response: ") +
+                               e.what()}};
+    return nullptr;
+  }
+  if (auth.refreshToken.empty() && current) {
+    auth.refreshToken = current->refresh_token;
   }
+  auto now = std::time(nullptr);
+  auto next = std::make_shared<const auth_token>(
+      auth_token{"Authorization: Bearer " + auth.idToken, auth.refreshToken,
+                 now, std::time_t(now + expires_in)});
+  std::atomic_store(&this->token, next);
+  res.code = 200;
+  return next;
+}
 
-  return outstring;
+/**
+ * Renew the oauth2 token on a background thread before it expires so that no
+ * request has to wait for authentication.
+ * @param lead_secs: how long before expiry to renew, capped at half the token
+ * lifetime
+ */
+void amber_sdk::enable_token_refresh(long lead_secs) {
+  this->disable_token_refresh();
+  std::lock_guard<std::mutex> guard(this->refresher.lock);
+  this->refresher.stop = false;
+  this->refresher.lead_secs = lead_secs;
+  this->refresher.worker = std::thread(&amber_sdk::refresh_loop, this);
 }
 
-static std::string base64_encode(const unsigned char *in, uint64_t len) {
+void amber_sdk::disable_token_refresh() {
+  {
+    std::lock_guard<std::mutex> guard(this->refresher.lock);
+    this->refresher.stop = true;
+  }
+  this->refresher.cv.notify_all();
+  if (this->refresher.worker.joinable()) {
+    this->refresher.worker.join();
+  }
+}
 
-  std::string out;
+void amber_sdk::refresh_loop() {
+  std::unique_lock<std::mutex> guard(this->refresher.lock);
+  while (!this->refresher.stop) {
+
+    // renew lead_secs before expiry, but never in the first half of the
+    // token lifetime
+    auto current = std::atomic_load(&this->token);
+    auto now = std::time(nullptr);
+    std::time_t due = now;
+    if (current) {
+      due = std::max(current->expires_at - this->refresher.lead_secs,
+                     current->issued_at +
+                         (current->expires_at - current->issued_at) / 2);
+    }
+    if (due > now) {
+      this->refresher.cv.wait_for(guard, std::chrono::seconds(due - now));
+      continue;
+    }
 
-  int val = 0, valb = -6;
-  for (auto idx = 0; idx < len; idx++) {
-    auto c = *(in + idx);
-    val = (val << 8) + c;
-    valb += 8;
-    while (valb >= 0) {
-      out.push_back(
-          "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
-              [(val >> valb) & 0x3F]);
-      valb -= 6;
+    guard.unlock();
+    bool ok;
+    try {
+      sdk_response res;
+      std::lock_guard<std::timed_mutex> auth_guard(this->auth_lock);
+      ok = this->request_token(res, true) != nullptr;
+    } catch (std::exception &) {
+      // nothing on this thread could handle it, treat it as a failed renewal
+      ok = false;
+    }
+    guard.lock();
+    if (!ok) {
+      // keep the current token and try again shortly
+      this->refresher.cv.wait_for(guard, std::chrono::seconds(10));
     }
   }
-  if (valb > -6)
-    out.push_back(
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
-            [((val << 8) >> (valb + 8)) & 0x3F]);
-  while (out.size() % 4)
-    out.push_back('=');
-  return out;
 }
 
 std::string &ltrim(std::string &s) {
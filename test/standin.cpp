@@ -0,0 +1,166 @@
+#include "standin.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <chrono>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+standin_server::standin_server(handler handle) : handle(std::move(handle)) {
+  this->listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (this->listener < 0 || bind(this->listener, (sockaddr *)&addr, len) != 0 ||
+      listen(this->listener, 64) != 0 ||
+      getsockname(this->listener, (sockaddr *)&addr, &len) != 0) {
+    throw std::runtime_error("stand-in server cannot listen");
+  }
+  this->port = ntohs(addr.sin_port);
+  this->acceptor = std::thread(&standin_server::accept_connections, this);
+}
+
+standin_server::~standin_server() {
+  this->stopping = true;
+  shutdown(this->listener, SHUT_RDWR);
+  this->acceptor.join();
+  close(this->listener);
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    for (int fd : this->open_fds) {
+      shutdown(fd, SHUT_RDWR);
+    }
+  }
+  for (auto &t : this->threads) {
+    t.join();
+  }
+  for (int fd : this->open_fds) {
+    close(fd);
+  }
+}
+
+std::string standin_server::url() const {
+  return "http://127.0.0.1:" + std::to_string(this->port) + "/v1";
+}
+
+void standin_server::set_login(std::string body, int delay_ms) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->login = std::move(body);
+  this->login_delay_ms = delay_ms;
+}
+
+void standin_server::accept_connections() {
+  while (true) {
+    int fd = accept(this->listener, nullptr, nullptr);
+    if (fd < 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->stopping) {
+      close(fd);
+      return;
+    }
+    this->open_fds.push_back(fd);
+    this->threads.emplace_back(&standin_server::serve, this, fd);
+  }
+}
+
+// read from fd until buffer holds at least size bytes
+static bool read_until(int fd, std::string &buffer, size_t size) {
+  char chunk[65536];
+  while (buffer.size() < size) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+      return false;
+    }
+    buffer.append(chunk, n);
+  }
+  return true;
+}
+
+static bool write_all(int fd, const std::string &data) {
+  for (size_t sent = 0; sent < data.size();) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+void standin_server::serve(int fd) {
+  std::string buffer;
+  while (true) {
+    // request line and headers
+    size_t end;
+    while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      if (!read_until(fd, buffer, buffer.size() + 1)) {
+        return;
+      }
+    }
+    standin_request req;
+    size_t at = buffer.find("\r\n");
+    std::string line = buffer.substr(0, at);
+    size_t sp = line.find(' ');
+    req.method = line.substr(0, sp);
+    req.path = line.substr(sp + 1, line.rfind(' ') - sp - 1);
+    while (at < end) {
+      size_t next = buffer.find("\r\n", at + 2);
+      std::string header = buffer.substr(at + 2, next - at - 2);
+      size_t colon = header.find(':');
+      if (colon != std::string::npos) {
+        std::string name = header.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        size_t value = header.find_first_not_of(' ', colon + 1);
+        req.headers[name] =
+            value == std::string::npos ? "" : header.substr(value);
+      }
+      at = next;
+    }
+    buffer.erase(0, end + 4);
+
+    // body, once curl is told to go on with it
+    size_t length = req.headers.count("content-length")
+                        ? std::stoul(req.headers["content-length"])
+                        : 0;
+    if (req.headers["expect"] == "100-continue" &&
+        !write_all(fd, "HTTP/1.1 100 Continue\r\n\r\n")) {
+      return;
+    }
+    if (!read_until(fd, buffer, length)) {
+      return;
+    }
+    req.body = buffer.substr(0, length);
+    buffer.erase(0, length);
+
+    standin_reply reply;
+    if (req.path.size() >= 7 &&
+        req.path.compare(req.path.size() - 7, 7, "/oauth2") == 0) {
+      int delay_ms;
+      {
+        std::lock_guard<std::mutex> guard(this->lock);
+        reply.body = this->login;
+        delay_ms = this->login_delay_ms;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    } else {
+      this->handle(req, reply);
+    }
+
+    std::string out =
+        "HTTP/1.1 " + std::to_string(reply.code) + " stand-in\r\n";
+    reply.headers["content-type"] = "application/json";
+    reply.headers["content-length"] = std::to_string(reply.body.size());
+    for (auto &h : reply.headers) {
+      out += h.first + ": " + h.second + "\r\n";
+    }
+    out += "\r\n" + reply.body;
+    if (!write_all(fd, out)) {
+      return;
+    }
+  }
+}
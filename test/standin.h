@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// request as the stand-in received it
+class standin_request {
+public:
+  std::string method;
+  std::string path;
+  std::map<std::string, std::string> headers; // names in lower case
+  std::string body;
+};
+
+class standin_reply {
+public:
+  int code{200};
+  std::map<std::string, std::string> headers;
+  std::string body;
+};
+
+/**
+ * Stand-in for the amber server within the test process: http/1.1 with
+ * keep-alive on a loopback port picked by the system, one thread per
+ * connection. Logins are answered with a token, every other request by the
+ * handler, which may be called from several threads at once.
+ */
+class standin_server {
+public:
+  typedef std::function<void(const standin_request &, standin_reply &)>
+      handler;
+
+  explicit standin_server(handler handle);
+
+  ~standin_server();
+
+  // api url to set as AMBER_SERVER
+  std::string url() const;
+
+  // body logins are answered with from now on, after delay_ms
+  void set_login(std::string body, int delay_ms = 0);
+
+private:
+  void accept_connections();
+
+  void serve(int fd);
+
+  handler handle;
+  std::string login{"{\"idToken\":\"token\",\"expiresIn\":\"3600\","
+                    "\"refreshToken\":\"refresh\",\"tokenType\":\"Bearer\"}"};
+  int login_delay_ms{};
+  int listener{-1};
+  int port{};
+  std::atomic<bool> stopping{};
+  std::mutex lock;
+  std::vector<int> open_fds;
+  std::vector<std::thread> threads;
+  std::thread acceptor;
+};
@@ -1,7 +1,9 @@
 #include "amber_sdk.h"
 #include "secrets.h"
+#include "standin.h"
 #include <gtest/gtest.h>
 #include <iostream>
+#include <thread>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -33,4 +35,123 @@ TEST(authenticate, Negative) {
     ASSERT_TRUE(false) << e.what();
   }
 }
+TEST(authenticate, BackgroundRefresh) {
+  try {
+    auto *amber = create_amber_client();
+    amber->enable_token_refresh();
+    list_sensors_response response;
+    EXPECT_EQ(amber->list_sensors(response), nullptr);
+    amber->disable_token_refresh();
+    EXPECT_EQ(amber->list_sensors(response), nullptr);
+    delete amber;
+  } catch (amber_except &e) {
+    ASSERT_TRUE(false) << e.what();
+  }
+}
+
+TEST(authenticate, SharedAcrossThreads) {
+  try {
+    auto *amber = create_amber_client();
+    std::atomic<int> failures{0};
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 8; i++) {
+      workers.emplace_back([amber, &failures]() {
+        for (int j = 0; j < 5; j++) {
+          list_sensors_response response;
+          auto err = amber->list_sensors(response);
+          if (err != nullptr) {
+            failures++;
+            delete err;
+          }
+        }
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    EXPECT_EQ(failures, 0);
+    delete amber;
+  } catch (amber_except &e) {
+    ASSERT_TRUE(false) << e.what();
+  }
+}
+// authentication against the in-process stand-in, no amber server needed
+class StandinAuthTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    saved_env = clear_env_variables();
+    setenv("AMBER_USERNAME", "user", 1);
+    setenv("AMBER_PASSWORD", "password", 1);
+    setenv("AMBER_SERVER", server.url().c_str(), 1);
+  }
+
+  void TearDown() override { restore_env_variables(saved_env); }
+
+  static std::string login(const std::string &expires_in) {
+    return "{\"idToken\":\"token\",\"expiresIn\":\"" + expires_in +
+           "\",\"refreshToken\":\"refresh\",\"tokenType\":\"Bearer\"}";
+  }
+
+  json saved_env;
+  standin_server server{[](const standin_request &, standin_reply &reply) {
+    reply.body = "[]";
+  }};
+};
+
+TEST_F(StandinAuthTest, MalformedTokenIsAnError) {
+  server.set_login(login("soon"));
+  amber_sdk amber("", "");
+  list_sensors_response response;
+  auto err = amber.list_sensors(response);
+  ASSERT_NE(err, nullptr);
+  EXPECT_EQ(err->code, 0);
+  EXPECT_NE(err->message.find("malformed oauth2 response"), std::string::npos);
+  delete err;
+
+  server.set_login(login("3600"));
+  EXPECT_EQ(amber.list_sensors(response), nullptr);
+}
+
+TEST_F(StandinAuthTest, RefreshSurvivesMalformedToken) {
+  // a two second token is renewed after one second
+  server.set_login(login("2"));
+  amber_sdk amber("", "");
+  list_sensors_response response;
+  ASSERT_EQ(amber.list_sensors(response), nullptr);
+  server.set_login("{\"idToken\":\"token\"}");
+  amber.enable_token_refresh();
+  std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+
+  // the failed renewals left the process running, a good login recovers
+  server.set_login(login("3600"));
+  EXPECT_EQ(amber.list_sensors(response), nullptr);
+  amber.disable_token_refresh();
+}
+
+TEST_F(StandinAuthTest, ScopeBoundsWaitForRefresh) {
+  server.set_login(login("3600"), 1000);
+  amber_sdk amber("", "");
+
+  // one thread logs in slowly, a scoped caller gives up at its deadline
+  // rather than wait for that login to finish
+  std::thread slow([&amber] {
+    list_sensors_response response;
+    EXPECT_EQ(amber.list_sensors(response), nullptr);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  auto start = std::chrono::steady_clock::now();
+  error_response *err;
+  {
+    request_scope scope(std::chrono::milliseconds(200));
+    list_sensors_response response;
+    err = amber.list_sensors(response);
+  }
+  auto waited = std::chrono::steady_clock::now() - start;
+  slow.join();
+  ASSERT_NE(err, nullptr);
+  EXPECT_EQ(err->message, "deadline exceeded");
+  delete err;
+  EXPECT_LT(waited, std::chrono::milliseconds(500));
+}
+
 } // namespace
@@ -0,0 +1,49 @@
+#include "amber_base64.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+TEST(base64, EncodesTestVectors) {
+  // RFC 4648 section 10
+  const char *vectors[][2] = {{"", ""},         {"f", "Zg=="},
+                              {"fo", "Zm8="},   {"foo", "Zm9v"},
+                              {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="},
+                              {"foobar", "Zm9vYmFy"}};
+  for (auto &v : vectors) {
+    std::string in = v[0];
+    std::string out(base64_size(in.size()), '?');
+    auto n = base64_encode_into(&out[0], (const unsigned char *)in.data(),
+                                in.size());
+    EXPECT_EQ(n, out.size());
+    EXPECT_EQ(out, v[1]);
+  }
+}
+
+TEST(base64, KernelsMatchScalar) {
+  std::mt19937 rng(3);
+  std::vector<unsigned char> in(1000);
+  for (auto &c : in) {
+    c = (unsigned char)rng();
+  }
+  base64_kernel kernels[] = {base64_kernel::ssse3, base64_kernel::avx2};
+  for (auto kernel : kernels) {
+    if (!base64_supported(kernel)) {
+      continue;
+    }
+    for (size_t len = 0; len <= in.size(); len++) {
+      std::string expected(base64_size(len), '?');
+      base64_encode_into(&expected[0], in.data(), len, base64_kernel::scalar);
+      // a guard past the end catches stores beyond base64_size
+      std::string out(base64_size(len) + 32, '#');
+      auto n = base64_encode_into(&out[0], in.data(), len, kernel);
+      ASSERT_EQ(n, expected.size()) << len;
+      ASSERT_EQ(out.substr(0, n), expected) << len;
+      ASSERT_EQ(out.substr(n), std::string(32, '#')) << len;
+    }
+  }
+}
+
+} // namespace
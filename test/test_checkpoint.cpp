@@ -0,0 +1,52 @@
+#include "amber_checkpoint.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+
+TEST(checkpoint, SaveLoadRoundTrip) {
+  std::string path = testing::TempDir() + "pretrain.checkpoint";
+  pretrain_checkpoint saved;
+  saved.reset("sensor-1", 84000000, 3500000);
+  saved.transaction = "tx-42";
+  saved.add_chunk(chunk_extent{0, 24000000, 1000000});
+  saved.add_chunk(chunk_extent{24000000, 48000000, 1000000});
+  saved.add_chunk(chunk_extent{48000000, 72000000, 1000000});
+  saved.acked[0] = true;
+  saved.acked[2] = true;
+  ASSERT_TRUE(saved.save(path)) << saved.error();
+
+  pretrain_checkpoint loaded;
+  ASSERT_TRUE(loaded.load(path)) << loaded.error();
+  EXPECT_TRUE(loaded.matches("sensor-1", 84000000, 3500000));
+  EXPECT_FALSE(loaded.matches("sensor-2", 84000000, 3500000));
+  EXPECT_FALSE(loaded.matches("sensor-1", 84000001, 3500000));
+  EXPECT_EQ(loaded.transaction, "tx-42");
+  EXPECT_EQ(loaded.acked, std::vector<bool>({true, false, true}));
+  EXPECT_EQ(loaded.acked_count(), 2u);
+  EXPECT_EQ(loaded.covered_samples(), 3000000u);
+  ASSERT_EQ(loaded.chunks.size(), 3u);
+  EXPECT_EQ(loaded.chunks[1].begin, 24000000u);
+  EXPECT_EQ(loaded.chunks[1].end, 48000000u);
+  EXPECT_EQ(loaded.chunks[1].samples, 1000000u);
+
+  pretrain_checkpoint::remove(path);
+  EXPECT_FALSE(loaded.load(path));
+  EXPECT_TRUE(loaded.error().empty());
+}
+
+TEST(checkpoint, RejectsDamagedFile) {
+  std::string path = testing::TempDir() + "damaged.checkpoint";
+  {
+    std::ofstream file(path);
+    file << "{\"sensorId\":\"sensor-1\",\"transac";
+  }
+  pretrain_checkpoint loaded;
+  EXPECT_FALSE(loaded.load(path));
+  EXPECT_FALSE(loaded.error().empty());
+  pretrain_checkpoint::remove(path);
+}
+
+} // namespace
@@ -0,0 +1,84 @@
+#include "amber_chunking.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace {
+
+// send chunks over a simulated link with a fixed cost per chunk, returning
+// the size picked last
+size_t simulate(chunk_planner &planner, int chunks, double overhead,
+                double rate) {
+  size_t size = 0;
+  for (int i = 0; i < chunks; i++) {
+    size = planner.next_size();
+    double bytes = size * 4.0;
+    planner.record(size, (size_t)bytes, overhead + bytes / rate);
+  }
+  return size;
+}
+
+TEST(chunking, FixedSizeIgnoresLink) {
+  chunk_planner planner;
+  EXPECT_EQ(simulate(planner, 5, 0.2, 1e5), 1000000u);
+  auto stats = planner.get_stats();
+  EXPECT_EQ(stats.chunks, 5u);
+  EXPECT_EQ(stats.sizes, std::vector<size_t>(5, 1000000));
+}
+
+TEST(chunking, AdaptiveFollowsLink) {
+  pretrain_chunk_options options;
+  options.adaptive = true;
+  options.target_seconds = 10;
+
+  // 100 kB/s: a chunk of 1M samples takes 40 s, 10 s fits about 245k
+  chunk_planner slow;
+  slow.set_options(options);
+  slow.begin_upload();
+  size_t size = simulate(slow, 12, 0.2, 1e5);
+  EXPECT_NEAR((double)size, 245000, 245000 * 0.05);
+  auto stats = slow.get_stats();
+  EXPECT_NEAR(stats.overhead_ms, 200, 20);
+  EXPECT_NEAR(stats.throughput, 1e5, 1e4);
+  EXPECT_EQ(stats.largest, 1000000u);
+  EXPECT_EQ(stats.sizes.size(), 12u);
+
+  // 100 MB/s: chunks double up to the largest allowed and stay there
+  chunk_planner fast;
+  fast.set_options(options);
+  simulate(fast, 1, 0.2, 1e8);
+  EXPECT_EQ(fast.next_size(), 2000000u);
+  EXPECT_EQ(simulate(fast, 6, 0.2, 1e8), options.max_samples);
+  EXPECT_EQ(fast.get_stats().largest, options.max_samples);
+}
+
+TEST(chunking, ConcurrentSendersShareLink) {
+  pretrain_chunk_options options;
+  options.adaptive = true;
+  options.target_seconds = 10;
+
+  // four senders on a 100 kB/s link: each chunk gets 25 kB/s, so a chunk
+  // takes four times as long as it would alone and 10 s fits about 61k
+  chunk_planner planner;
+  planner.set_options(options);
+  planner.begin_upload(4);
+  std::vector<std::thread> senders;
+  for (int i = 0; i < 4; i++) {
+    senders.emplace_back([&planner] {
+      for (int j = 0; j < 6; j++) {
+        size_t size = planner.next_size();
+        double bytes = size * 4.0;
+        planner.record(size, (size_t)bytes, 0.2 + 4 * bytes / 1e5, 4);
+      }
+    });
+  }
+  for (auto &t : senders) {
+    t.join();
+  }
+  auto stats = planner.get_stats();
+  EXPECT_EQ(stats.chunks, 24u);
+  EXPECT_NEAR(stats.throughput, 1e5, 1e4);
+  EXPECT_NEAR(stats.overhead_ms, 200, 20);
+  EXPECT_NEAR((double)planner.next_size(), 61250, 61250 * 0.05);
+}
+
+} // namespace
@@ -0,0 +1,90 @@
+#include "amber_csv.h"
+#include "amber_mmap.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+
+namespace {
+
+TEST(csv, ParseFloatRoundsLikeStrtof) {
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<uint32_t> bits;
+  const char *formats[] = {"%.9g", "%.3f", "%.17g", "%.1e", "%.12e"};
+  char text[64];
+  for (int i = 0; i < 200000; i++) {
+    uint32_t b = bits(rng);
+    float f;
+    memcpy(&f, &b, sizeof(f));
+    if (!std::isfinite(f)) {
+      continue;
+    }
+    snprintf(text, sizeof(text), formats[i % 5], f);
+    float parsed;
+    auto end = parse_float(text, text + strlen(text), parsed);
+    float expected = strtof(text, nullptr);
+    if (std::fabs(expected) > FLT_MAX) {
+      continue; // out of range for the reference as well
+    }
+    ASSERT_NE(end, nullptr) << text;
+    ASSERT_EQ(end, text + strlen(text)) << text;
+    ASSERT_EQ(parsed, expected) << text;
+  }
+}
+
+TEST(csv, ParseSplitsAcrossThreads) {
+  std::string csv;
+  for (int i = 0; i < 400000; i++) {
+    csv += std::to_string(i) + ".25" + (i % 7 == 6 ? "\r\n" : ", ");
+  }
+  std::vector<float> one, many;
+  ASSERT_TRUE(parse_csv_floats(csv, one, 1));
+  ASSERT_TRUE(parse_csv_floats(csv, many, 4));
+  ASSERT_EQ(one.size(), 400000);
+  EXPECT_EQ(one, many);
+  EXPECT_EQ(one[123456], 123456.25f);
+
+  std::vector<float> out;
+  size_t bad = 0;
+  EXPECT_TRUE(parse_csv_floats(" 1,,2\n\n-3e2 ", out));
+  EXPECT_EQ(out, std::vector<float>({1, 2, -300}));
+  EXPECT_FALSE(parse_csv_floats("1,2,x3,4", out, 1, &bad));
+  EXPECT_EQ(bad, 4);
+  EXPECT_FALSE(parse_csv_floats("1,2e", out, 1, &bad));
+  EXPECT_EQ(bad, 2);
+}
+
+TEST(csv, ParseChunksOfMappedFile) {
+  std::string path = testing::TempDir() + "amber_csv_chunks.csv";
+  {
+    std::ofstream f(path);
+    for (int i = 0; i < 1000; i++) {
+      f << i << (i % 10 == 9 ? "\n" : ",");
+    }
+  }
+  mapped_file file;
+  ASSERT_TRUE(file.open(path)) << file.error();
+  ASSERT_EQ(count_csv_values(file.data(), file.size()), 1000);
+
+  // chunks pick up exactly where the previous one stopped
+  const char *p = file.data();
+  const char *end = p + file.size();
+  std::vector<float> chunk(300), all;
+  size_t count;
+  do {
+    ASSERT_TRUE(parse_csv_values(p, end, chunk.data(), chunk.size(), count));
+    all.insert(all.end(), chunk.begin(), chunk.begin() + count);
+    file.release(0, p - file.data());
+  } while (count == chunk.size());
+  ASSERT_EQ(all.size(), 1000);
+  EXPECT_EQ(all[999], 999);
+  std::remove(path.c_str());
+
+  EXPECT_FALSE(file.open(path));
+}
+
+} // namespace
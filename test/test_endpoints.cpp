@@ -1,3 +1,6 @@
+#include "amber_batcher.h"
+#include "amber_pipeline.h"
+#include "amber_scheduler.h"
 #include "amber_sdk.h"
 #include "secrets.h"
 #include <fstream>
@@ -257,6 +260,41 @@ TEST_F(endpoints, GetStatus) {
   EXPECT_EQ(response.numClusters, 358);
 }
 
+TEST_F(endpoints, GetStatusHedged) {
+  amber->set_hedging(true, 0.9, 10);
+  for (int i = 0; i < 25; i++) {
+    get_status_response response;
+    ASSERT_EQ(amber->get_status(response, endpoints::get_sid()), nullptr);
+    EXPECT_EQ(response.numClusters, 358);
+  }
+  amber->set_hedging(false);
+  EXPECT_GT(amber->get_latency("status"), 0);
+  EXPECT_LE(amber->get_hedge_stats().hedge_wins,
+            amber->get_hedge_stats().hedged);
+}
+
+TEST_F(endpoints, GetStatusDeadline) {
+  get_status_response response;
+  {
+    request_scope scope(std::chrono::milliseconds(0));
+    auto err = amber->get_status(response, endpoints::get_sid());
+    ASSERT_NE(err, nullptr);
+    EXPECT_EQ(err->message, "deadline exceeded");
+    delete err;
+  }
+  cancel_token cancel;
+  cancel.cancel();
+  {
+    request_scope scope(&cancel);
+    auto err = amber->get_status(response, endpoints::get_sid());
+    ASSERT_NE(err, nullptr);
+    EXPECT_EQ(err->message, "cancelled");
+    delete err;
+  }
+  request_scope scope(std::chrono::seconds(30));
+  EXPECT_EQ(amber->get_status(response, endpoints::get_sid()), nullptr);
+}
+
 TEST_F(endpoints, GetStatusNegative) {
   get_status_response response;
   std::string bad_sensor_id = "bogus-sensor-id";
@@ -284,6 +322,126 @@ TEST_F(endpoints, StreamSensor) {
   // EXPECT_EQ(response.SI, 3);
 }
 
+TEST_F(endpoints, StreamSensorAsync) {
+  std::vector<std::future<async_result<stream_sensor_response>>> futures;
+  for (int i = 0; i < 10; i++) {
+    futures.push_back(amber->stream_sensor_async(endpoints::get_sid(), "1,2,3"));
+  }
+  for (auto &future : futures) {
+    auto result = future.get();
+    ASSERT_EQ(result.err, nullptr);
+    EXPECT_EQ(result.response.state, "Monitoring");
+  }
+
+  std::promise<error_response *> done;
+  amber->get_status_async(endpoints::get_sid(),
+                          [&done](error_response *err,
+                                  get_status_response &response) {
+                            done.set_value(err);
+                          });
+  EXPECT_EQ(done.get_future().get(), nullptr);
+}
+
+TEST_F(endpoints, StreamSensorHandle) {
+  auto handle = amber->prepare_sensor(endpoints::get_sid());
+  EXPECT_EQ(handle->sensor_id(), endpoints::get_sid());
+  for (int i = 0; i < 3; i++) {
+    stream_sensor_response response;
+    ASSERT_EQ(handle->stream_sensor(response, "1,2,3"), nullptr);
+    EXPECT_EQ(response.state, "Monitoring");
+  }
+}
+
+TEST_F(endpoints, StreamSensorFloats) {
+  std::vector<float> data = {1, 2, 3};
+  stream_sensor_response response;
+  ASSERT_EQ(amber->stream_sensor(response, endpoints::get_sid(), data),
+            nullptr);
+  EXPECT_EQ(response.state, "Monitoring");
+
+  auto handle = amber->prepare_sensor(endpoints::get_sid());
+  ASSERT_EQ(handle->stream_sensor(response, data.data(), data.size()),
+            nullptr);
+  EXPECT_EQ(response.state, "Monitoring");
+}
+
+TEST_F(endpoints, StreamBatcher) {
+  size_t streamed = 0;
+  int failures = 0;
+  batch_options options;
+  options.max_samples = 100;
+  stream_batcher batcher(*amber, endpoints::get_sid(), options,
+                         [&](error_response *err, stream_sensor_response &res,
+                             size_t samples) {
+                           streamed += samples;
+                           if (err != nullptr) {
+                             failures++;
+                             delete err;
+                           }
+                         });
+  for (int i = 0; i < 250; i++) {
+    batcher.push((float)(i % 10));
+  }
+  batcher.flush();
+  auto stats = batcher.get_stats();
+  EXPECT_EQ(failures, 0);
+  EXPECT_EQ(streamed, 250);
+  EXPECT_EQ(stats.samples, 250);
+  EXPECT_GE(stats.batches, 3);
+}
+
+TEST_F(endpoints, StreamPipeline) {
+  std::vector<uint64_t> order;
+  int failures = 0;
+  pipeline_options options;
+  options.depth = 4;
+  stream_pipeline pipeline(*amber, endpoints::get_sid(), options,
+                           [&](uint64_t seq, error_response *err,
+                               stream_sensor_response &res) {
+                             order.push_back(seq);
+                             if (err != nullptr) {
+                               failures++;
+                               delete err;
+                             }
+                           });
+  std::vector<float> data = {1, 2, 3, 4, 5};
+  for (int i = 0; i < 10; i++) {
+    pipeline.submit(data.data(), data.size());
+  }
+  pipeline.drain();
+  EXPECT_EQ(failures, 0);
+  ASSERT_EQ(order.size(), 10);
+  for (uint64_t i = 0; i < order.size(); i++) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST_F(endpoints, StreamScheduler) {
+  int delivered = 0;
+  int failures = 0;
+  scheduler_options options;
+  options.workers = 2;
+  stream_scheduler scheduler(*amber, options,
+                             [&](const std::string &sensor_id,
+                                 error_response *err,
+                                 stream_sensor_response &res) {
+                               EXPECT_EQ(sensor_id, endpoints::get_sid());
+                               delivered++;
+                               if (err != nullptr) {
+                                 failures++;
+                                 delete err;
+                               }
+                             });
+  std::vector<float> data = {1, 2, 3, 4, 5};
+  for (int i = 0; i < 10; i++) {
+    scheduler.enqueue(endpoints::get_sid(), data);
+  }
+  scheduler.drain();
+  EXPECT_EQ(delivered, 10);
+  EXPECT_EQ(failures, 0);
+  EXPECT_EQ(scheduler.get_stats().queued, 0);
+}
+
 TEST_F(endpoints, StreamSensorNegative) {
   stream_sensor_response response;
   std::string bad_sensor_id = "bogus-sensor-id";
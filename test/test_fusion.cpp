@@ -0,0 +1,78 @@
+#include "amber_fusion.h"
+#include "amber_sdk.h"
+#include <cmath>
+#include <gtest/gtest.h>
+
+namespace {
+
+TEST(fusion, EncoderMatchesRequest) {
+  std::vector<amber_models::FusionConfig> config{
+      {"a", "submit"}, {"b\"quoted", "nosubmit"}, {"c", "submit"}};
+  fusion_encoder encoder(config, "submit");
+  ASSERT_EQ(encoder.size(), 3);
+  EXPECT_EQ(encoder.index("c"), 2);
+  EXPECT_THROW(encoder.index("d"), amber_except);
+
+  // every update is patched into the same body
+  amber_models::PutStreamRequest request;
+  request.submitRule = "submit";
+  for (float v : {1.5f, -0.1f, 123456.78f, 3e-7f, -3.4028235e38f}) {
+    request.vector = {{"a", v, ""}, {"b\"quoted", v / 3, ""}, {"c", 0, ""}};
+    encoder.set(0, v);
+    encoder.set(encoder.index("b\"quoted"), v / 3);
+
+    auto sent = json::parse(encoder.body()).get<amber_models::PutStreamRequest>();
+    ASSERT_EQ(sent.submitRule, request.submitRule);
+    ASSERT_EQ(sent.vector.size(), request.vector.size());
+    for (size_t i = 0; i < sent.vector.size(); i++) {
+      EXPECT_EQ(sent.vector[i].label, request.vector[i].label);
+      EXPECT_EQ(sent.vector[i].value, request.vector[i].value);
+    }
+  }
+
+  // values json cannot hold go out as null
+  encoder.set(1, NAN);
+  EXPECT_TRUE(json::parse(encoder.body())["vector"][1]["value"].is_null());
+}
+
+TEST(fusion, AssemblerHonorsSubmitRule) {
+  amber_sdk amber("default", "test/test.Amber.license");
+  int results = 0;
+  auto count = [&results](error_response *err, stream_fusion_response &) {
+    results++;
+    delete err;
+  };
+
+  {
+    fusion_assembler assembler(
+        amber, "fusion-test", assembler_options(), count,
+        {{"a", "nosubmit"}, {"b", "submit"}, {"c", "nosubmit"}});
+
+    // nothing goes out until every feature has a value
+    EXPECT_FALSE(assembler.update("b", 1));
+    EXPECT_FALSE(assembler.update("a", 1));
+    EXPECT_TRUE(assembler.update("c", 1) || assembler.update("b", 2));
+
+    // only the submitting feature triggers a request
+    int sent = 0;
+    for (int i = 0; i < 100; i++) {
+      sent += assembler.update("a", (float)i) ? 1 : 0;
+      sent += assembler.update(2, (float)i) ? 1 : 0;
+      if (i % 10 == 0) {
+        sent += assembler.update("b", (float)i) ? 1 : 0;
+      }
+    }
+    EXPECT_EQ(sent, 10);
+    assembler.submit();
+    assembler.drain();
+
+    auto stats = assembler.get_stats();
+    EXPECT_EQ(stats.submits, 12);
+    EXPECT_EQ(stats.updates, 214);
+    EXPECT_EQ(stats.suppressed, 203);
+    EXPECT_EQ(stats.queued, 0);
+  }
+  EXPECT_EQ(results, 12);
+}
+
+} // namespace
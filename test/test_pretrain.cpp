@@ -0,0 +1,309 @@
+#include "amber_checkpoint.h"
+#include "amber_sdk.h"
+#include "secrets.h"
+#include "standin.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+static std::vector<unsigned char> base64_decode(const std::string &in) {
+  static const std::string alphabet =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::vector<unsigned char> out;
+  unsigned bits = 0;
+  int count = 0;
+  for (char c : in) {
+    auto v = alphabet.find(c);
+    if (v == std::string::npos) {
+      break;
+    }
+    bits = (bits << 6) | (unsigned)v;
+    count += 6;
+    if (count >= 8) {
+      count -= 8;
+      out.push_back((unsigned char)(bits >> count));
+    }
+  }
+  return out;
+}
+
+// pretrain endpoint of the stand-in, recording the chunks it accepts
+class pretrain_standin {
+public:
+  std::mutex lock;
+  std::map<size_t, std::vector<float>> chunks; // accepted, by chunk number
+  std::vector<std::string> announced;          // amberchunk of every post
+  std::vector<std::string> transactions;       // ambertransaction of every post
+  size_t posts{};
+  size_t gets{};
+  size_t active{};
+  size_t most_active{}; // most chunks in flight at once
+  size_t fail_chunk{};  // chunk number answered at once with 400, none if 0
+  std::string transaction{"tx-7"}; // opened by a chunk sent without one
+  int delay_ms{};
+  std::function<void(size_t)> on_chunk; // called before a chunk is answered
+
+  void handle(const standin_request &req, standin_reply &reply) {
+    if (req.method == "GET") {
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->gets++;
+      reply.body = "{\"state\":\"Pretrained\",\"message\":\"ready\"}";
+      return;
+    }
+
+    std::string chunk = req.headers.at("amberchunk");
+    size_t number = std::stoul(chunk.substr(0, chunk.find(':')));
+    std::string transaction = req.headers.count("ambertransaction")
+                                  ? req.headers.at("ambertransaction")
+                                  : "";
+    {
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->posts++;
+      this->announced.push_back(chunk);
+      this->transactions.push_back(transaction);
+      if (transaction.empty()) {
+        transaction = this->transaction;
+      }
+      this->active++;
+      this->most_active = std::max(this->most_active, this->active);
+    }
+    if (number != this->fail_chunk) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(this->delay_ms));
+    }
+    if (this->on_chunk) {
+      this->on_chunk(number);
+    }
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->active--;
+    if (number == this->fail_chunk) {
+      reply.code = 400;
+      reply.body = "{\"code\":400,\"message\":\"injected failure\"}";
+      return;
+    }
+    auto bytes = base64_decode(json::parse(req.body).at("data"));
+    std::vector<float> samples(bytes.size() / sizeof(float));
+    memcpy(samples.data(), bytes.data(), samples.size() * sizeof(float));
+    this->chunks[number] = samples;
+    reply.code = 202;
+    reply.headers["ambertransaction"] = transaction;
+    reply.body =
+        "{\"state\":\"Pretraining\",\"message\":\"\",\"amberChunk\":\"" +
+        chunk + "\",\"amberTransaction\":\"" + transaction + "\"}";
+  }
+};
+
+class PretrainTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    saved_env = clear_env_variables();
+    setenv("AMBER_USERNAME", "user", 1);
+    setenv("AMBER_PASSWORD", "password", 1);
+    setenv("AMBER_SERVER", server.url().c_str(), 1);
+  }
+
+  void TearDown() override { restore_env_variables(saved_env); }
+
+  // a client uploading fixed chunks of chunk_samples, in_flight at a time
+  std::unique_ptr<amber_sdk> client(size_t chunk_samples, size_t in_flight) {
+    std::unique_ptr<amber_sdk> amber(new amber_sdk("", ""));
+    pretrain_chunk_options options;
+    options.initial_samples = chunk_samples;
+    options.min_samples = chunk_samples;
+    amber->set_pretrain_chunking(options);
+    amber->set_pretrain_concurrency(in_flight);
+    amber->set_pretrain_compression(compression_codec::none);
+    return amber;
+  }
+
+  // samples 0, 1, ... count - 1 as csv
+  static std::string csv(size_t count) {
+    std::string data;
+    for (size_t i = 0; i < count; i++) {
+      data += (i ? "," : "") + std::to_string(i);
+    }
+    return data;
+  }
+
+  // samples the stand-in accepted, in chunk order
+  std::vector<float> received() {
+    std::vector<float> all;
+    for (auto &c : standin.chunks) {
+      all.insert(all.end(), c.second.begin(), c.second.end());
+    }
+    return all;
+  }
+
+  static std::vector<float> sequence(size_t count) {
+    std::vector<float> all;
+    for (size_t i = 0; i < count; i++) {
+      all.push_back((float)i);
+    }
+    return all;
+  }
+
+  json saved_env;
+  pretrain_standin standin;
+  standin_server server{
+      [this](const standin_request &req, standin_reply &reply) {
+        standin.handle(req, reply);
+      }};
+};
+
+TEST_F(PretrainTest, SendsChunksConcurrently) {
+  standin.delay_ms = 20;
+  auto amber = client(100, 3);
+
+  // ten chunks pass through the four bodies there are to encode into, so
+  // the senders must hand every body back
+  pretrain_sensor_response response;
+  auto err = amber->pretrain_sensor_xl(response, "sensor-1", csv(1000), false,
+                                       false);
+  ASSERT_EQ(err, nullptr) << err->message;
+  EXPECT_EQ(standin.posts, 10u);
+  EXPECT_EQ(received(), sequence(1000));
+  EXPECT_GT(standin.most_active, 1u);
+  EXPECT_LE(standin.most_active, 3u);
+  for (size_t i = 0; i < standin.posts; i++) {
+    EXPECT_EQ(standin.announced[i].substr(standin.announced[i].find(':')),
+              ":10");
+  }
+
+  // only the first chunk goes out before the transaction is open
+  ASSERT_EQ(standin.announced[0], "1:10");
+  EXPECT_EQ(standin.transactions[0], "");
+  for (size_t i = 1; i < standin.posts; i++) {
+    EXPECT_EQ(standin.transactions[i], "tx-7");
+  }
+  EXPECT_EQ(response.amberChunk, "10:10");
+  EXPECT_EQ(standin.gets, 0u);
+}
+
+TEST_F(PretrainTest, FailedChunkStopsUpload) {
+  standin.delay_ms = 10;
+  standin.fail_chunk = 4;
+  auto amber = client(100, 2);
+
+  // the encoder is waiting for a body to encode into when chunk 4 fails
+  pretrain_sensor_response response;
+  auto err = amber->pretrain_sensor_xl(response, "sensor-1", csv(2000), false,
+                                       false);
+  ASSERT_NE(err, nullptr);
+  EXPECT_EQ(err->code, 400);
+  EXPECT_EQ(err->message, "injected failure");
+  delete err;
+  EXPECT_GE(standin.posts, 4u);
+  EXPECT_LE(standin.posts, 5u);
+  EXPECT_EQ(standin.chunks.count(4), 0u);
+}
+
+TEST_F(PretrainTest, CancelStopsUpload) {
+  cancel_token stop;
+  standin.on_chunk = [&stop](size_t number) {
+    if (number == 3) {
+      stop.cancel();
+    }
+  };
+  auto amber = client(100, 1);
+
+  pretrain_sensor_response response;
+  error_response *err;
+  {
+    request_scope scope(&stop);
+    err = amber->pretrain_sensor_xl(response, "sensor-1", csv(1000), false,
+                                    false);
+  }
+  ASSERT_NE(err, nullptr);
+  EXPECT_EQ(err->code, 0);
+  EXPECT_EQ(err->message, "cancelled");
+  delete err;
+  EXPECT_EQ(standin.posts, 3u);
+}
+
+TEST_F(PretrainTest, AsksForStateWhenLastChunkWasAccepted) {
+  std::string data = csv(300);
+  std::string path = testing::TempDir() + "pretrain_last.checkpoint";
+  pretrain_checkpoint saved;
+  saved.reset("sensor-1", data.size(), 300);
+  saved.transaction = "tx-7";
+  saved.add_chunk(chunk_extent{0, 100, 100});
+  saved.add_chunk(chunk_extent{100, 200, 100});
+  saved.add_chunk(chunk_extent{200, 300, 100});
+  saved.acked[0] = true;
+  saved.acked[2] = true;
+  ASSERT_TRUE(saved.save(path)) << saved.error();
+
+  // only the middle chunk is missing, its response is not the last one
+  auto amber = client(100, 2);
+  pretrain_sensor_response response;
+  auto err = amber->pretrain_sensor_xl(response, "sensor-1", data, false,
+                                       false, path);
+  ASSERT_EQ(err, nullptr) << err->message;
+  EXPECT_EQ(standin.announced, std::vector<std::string>({"2:3"}));
+  EXPECT_EQ(standin.transactions, std::vector<std::string>({"tx-7"}));
+  auto all = sequence(300);
+  EXPECT_EQ(standin.chunks[2],
+            std::vector<float>(all.begin() + 100, all.begin() + 200));
+  EXPECT_EQ(standin.gets, 1u);
+  EXPECT_EQ(response.state, "Pretrained");
+  EXPECT_EQ(response.message, "ready");
+  EXPECT_FALSE(std::ifstream(path).good());
+}
+
+TEST_F(PretrainTest, ResumesFromCheckpoint) {
+  std::string data = csv(1000);
+  std::string path = testing::TempDir() + "pretrain_resume.checkpoint";
+  std::remove(path.c_str());
+
+  // the first attempt stops at chunk 4 of 10
+  standin.fail_chunk = 4;
+  pretrain_sensor_response response;
+  auto err = client(100, 1)->pretrain_sensor_xl(response, "sensor-1", data,
+                                                false, false, path);
+  ASSERT_NE(err, nullptr);
+  delete err;
+  pretrain_checkpoint interrupted;
+  ASSERT_TRUE(interrupted.load(path)) << interrupted.error();
+  EXPECT_EQ(interrupted.transaction, "tx-7");
+  EXPECT_EQ(interrupted.acked_count(), 3u);
+  ASSERT_GE(interrupted.chunks.size(), 4u);
+
+  // resume with larger chunks: the chunks already encoded keep their extent,
+  // the rest are cut to the new size and announced with the new count
+  size_t known = interrupted.chunks.size();
+  size_t count = known + (1000 - interrupted.covered_samples() + 149) / 150;
+  size_t before = standin.posts;
+  standin.fail_chunk = 0;
+  standin.transaction = "tx-8";
+  err = client(150, 2)->pretrain_sensor_xl(response, "sensor-1", data, false,
+                                           false, path);
+  ASSERT_EQ(err, nullptr) << err->message;
+
+  std::vector<std::string> resumed(standin.announced.begin() + before,
+                                   standin.announced.end());
+  std::sort(resumed.begin(), resumed.end(),
+            [](const std::string &a, const std::string &b) {
+              return std::stoul(a) < std::stoul(b);
+            });
+  std::vector<std::string> expected;
+  for (size_t number = 4; number <= count; number++) {
+    expected.push_back(std::to_string(number) + ":" + std::to_string(count));
+  }
+  EXPECT_EQ(resumed, expected);
+  for (size_t i = before; i < standin.posts; i++) {
+    EXPECT_EQ(standin.transactions[i], "tx-7");
+  }
+  EXPECT_EQ(received(), sequence(1000));
+  EXPECT_EQ(response.amberChunk, expected.back());
+  EXPECT_FALSE(std::ifstream(path).good());
+}
+
+} // namespace
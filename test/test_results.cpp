@@ -0,0 +1,79 @@
+#include "amber_decode.h"
+#include "amber_results.h"
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+
+// a stream response with n inferences numbered from first
+std::string stream_body(int first, int n) {
+  std::string ids, ams;
+  for (int i = 0; i < n; i++) {
+    ids += (i > 0 ? "," : "") + std::to_string(first + i);
+    ams += (i > 0 ? "," : "") + std::to_string(first + i) + ".5";
+  }
+  return "{\"state\":\"Monitoring\",\"totalInferences\":" +
+         std::to_string(first + n) + ",\"ID\":[" + ids + "],\"AW\":[" + ids +
+         "],\"AM\":[" + ams + "],\"extra\":{\"ID\":[-1]}}";
+}
+
+TEST(results, ColumnsKeepTheLatestInOrder) {
+  result_store store(8);
+  ASSERT_TRUE(store.append(stream_body(0, 5)));
+  EXPECT_EQ(store.size(), 5);
+  EXPECT_EQ(store.status().state, "Monitoring");
+
+  // wrap the ring several times, spans stay contiguous and in order
+  for (int first = 5; first < 50; first += 3) {
+    ASSERT_TRUE(store.append(stream_body(first, 3)));
+    auto id = store.id();
+    auto am = store.am(4);
+    ASSERT_EQ(id.size(), 8);
+    ASSERT_EQ(am.size(), 4);
+    for (size_t i = 0; i < id.size(); i++) {
+      EXPECT_EQ(id[i], first + 3 - 8 + (int)i);
+      EXPECT_EQ(store.aw()[i], id[i]);
+    }
+    for (size_t i = 0; i < am.size(); i++) {
+      EXPECT_EQ(am[i], first + 3 - 4 + (int)i + 0.5f);
+    }
+    EXPECT_EQ(store.status().totalInferences, (uint64_t)first + 3);
+  }
+  EXPECT_EQ(store.total(), 50);
+  EXPECT_TRUE(store.ri().empty());
+  EXPECT_FALSE(store.append("{\"ID\":[1,"));
+
+  // the decoded and the copied path agree
+  amber_models::PostStreamResponse response;
+  ASSERT_TRUE(decode_response(stream_body(100, 2), response));
+  store.clear();
+  store.append(response);
+  ASSERT_EQ(store.id().size(), 2);
+  EXPECT_EQ(store.id()[1], 101);
+  EXPECT_EQ(store.am()[0], 100.5f);
+}
+
+TEST(results, MalformedBodyLeavesColumnsAligned) {
+  result_store store(4);
+  ASSERT_TRUE(store.append(stream_body(0, 6)));
+
+  // the body breaks off after ID and part of AW were read
+  EXPECT_FALSE(store.append("{\"state\":\"Learning\",\"ID\":[6,7],"
+                            "\"AW\":[6,"));
+  EXPECT_EQ(store.total(), 6);
+  EXPECT_EQ(store.status().state, "Monitoring");
+  ASSERT_EQ(store.id().size(), 4);
+  ASSERT_EQ(store.aw().size(), 4);
+  ASSERT_EQ(store.am().size(), 4);
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT_EQ(store.id()[i], 2 + (int)i);
+    EXPECT_EQ(store.aw()[i], store.id()[i]);
+    EXPECT_EQ(store.am()[i], store.id()[i] + 0.5f);
+  }
+
+  ASSERT_TRUE(store.append(stream_body(6, 1)));
+  EXPECT_EQ(store.id()[3], 6);
+  EXPECT_EQ(store.aw()[3], 6);
+}
+
+} // namespace
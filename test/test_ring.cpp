@@ -0,0 +1,93 @@
+#include "amber_ring.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::vector<float> drain(ingest_queue &queue) {
+  std::vector<float> out(256);
+  size_t n = 0, got;
+  while ((got = queue.pop(out.data() + n, out.size() - n)) > 0) {
+    n += got;
+  }
+  out.resize(n);
+  return out;
+}
+
+TEST(ring, MultiProducerKeepsPerProducerOrder) {
+  mpsc_ring<uint64_t> ring(1024);
+  const uint64_t count = 20000;
+  std::vector<std::thread> producers;
+  for (uint64_t p = 0; p < 2; p++) {
+    producers.emplace_back([&ring, p, count] {
+      for (uint64_t i = 0; i < count; i++) {
+        while (!ring.try_push(p << 32 | i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  uint64_t next[2] = {0, 0};
+  uint64_t value;
+  for (uint64_t got = 0; got < 2 * count;) {
+    if (ring.try_pop(value)) {
+      ASSERT_EQ(value & 0xffffffff, next[value >> 32]++);
+      got++;
+    }
+  }
+  for (auto &t : producers) {
+    t.join();
+  }
+  EXPECT_EQ(ring.size(), 0);
+}
+
+TEST(ring, DropPolicies) {
+  ingest_options options;
+  options.capacity = 8;
+  options.multi_producer = false;
+
+  options.policy = overload_policy::drop_newest;
+  ingest_queue newest(options);
+  for (int i = 0; i < 20; i++) {
+    newest.push((float)i);
+  }
+  EXPECT_EQ(newest.get_stats().dropped, 12);
+  EXPECT_EQ(drain(newest),
+            std::vector<float>({0, 1, 2, 3, 4, 5, 6, 7}));
+
+  options.policy = overload_policy::drop_oldest;
+  ingest_queue oldest(options);
+  for (int i = 0; i < 20; i++) {
+    oldest.push((float)i);
+  }
+  EXPECT_EQ(oldest.get_stats().dropped, 12);
+  EXPECT_EQ(drain(oldest),
+            std::vector<float>({12, 13, 14, 15, 16, 17, 18, 19}));
+}
+
+TEST(ring, SpillKeepsOrder) {
+  ingest_options options;
+  options.capacity = 8;
+  options.policy = overload_policy::spill;
+  ingest_queue queue(options);
+  for (int i = 0; i < 20; i++) {
+    queue.push((float)i);
+  }
+  auto stats = queue.get_stats();
+  EXPECT_EQ(stats.depth, 20);
+  EXPECT_EQ(stats.spilled, 12);
+  EXPECT_EQ(stats.dropped, 0);
+
+  float first[4];
+  ASSERT_EQ(queue.pop(first, 4), 4);
+  queue.push(20);
+  auto rest = drain(queue);
+  ASSERT_EQ(rest.size(), 17);
+  for (size_t i = 0; i < rest.size(); i++) {
+    EXPECT_EQ(rest[i], (float)(i + 4));
+  }
+  EXPECT_EQ(queue.get_stats().depth, 0);
+}
+
+} // namespace
@@ -0,0 +1,137 @@
+#include "amber_sdk.h"
+#include "secrets.h"
+#include "standin.h"
+#include <gtest/gtest.h>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// float streaming against the in-process stand-in, no amber server needed
+class StreamFormatTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    saved_env = clear_env_variables();
+    setenv("AMBER_USERNAME", "user", 1);
+    setenv("AMBER_PASSWORD", "password", 1);
+    setenv("AMBER_SERVER", server.url().c_str(), 1);
+  }
+
+  void TearDown() override { restore_env_variables(saved_env); }
+
+  // formats of the stream requests received since the last call
+  std::vector<std::string> take_formats() {
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<std::string> taken;
+    taken.swap(formats);
+    return taken;
+  }
+
+  json saved_env;
+  std::mutex lock;
+  std::vector<std::string> formats; // "packed" or "csv", in order
+  std::map<std::string, std::string> last_headers;
+  bool accept_packed{};
+  bool accept_csv{};
+  standin_server server{
+      [this](const standin_request &req, standin_reply &reply) {
+        bool packed = req.body.find("packed-float") != std::string::npos;
+        std::lock_guard<std::mutex> guard(lock);
+        formats.push_back(packed ? "packed" : "csv");
+        last_headers = req.headers;
+        if (packed ? accept_packed : accept_csv) {
+          reply.body = "{\"state\":\"Monitoring\",\"message\":\"\"}";
+        } else {
+          reply.code = 400;
+          reply.body = "{\"code\":400,\"message\":\"sensor not configured\"}";
+        }
+      }};
+};
+
+TEST_F(StreamFormatTest, PackedStaysWhenAccepted) {
+  accept_packed = true;
+  accept_csv = true;
+  amber_sdk amber("", "");
+  float data[] = {1, 2, 3};
+  stream_sensor_response response;
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(amber.stream_sensor(response, "sensor-1", data, 3), nullptr);
+  }
+  EXPECT_EQ(take_formats(), std::vector<std::string>({"packed", "packed"}));
+}
+
+TEST_F(StreamFormatTest, CsvWhenPackedIsRejected) {
+  accept_csv = true;
+  amber_sdk amber("", "");
+  float data[] = {1, 2, 3};
+  stream_sensor_response response;
+  ASSERT_EQ(amber.stream_sensor(response, "sensor-1", data, 3), nullptr);
+  EXPECT_EQ(take_formats(), std::vector<std::string>({"packed", "csv"}));
+  ASSERT_EQ(amber.stream_sensor(response, "sensor-1", data, 3), nullptr);
+  EXPECT_EQ(take_formats(), std::vector<std::string>({"csv"}));
+}
+
+TEST_F(StreamFormatTest, BothFormatsRejectedSettlesOnce) {
+  amber_sdk amber("", "");
+  float data[] = {1, 2, 3};
+  stream_sensor_response response;
+
+  // the probe costs one extra request, after that a failing sensor is sent
+  // one request per call
+  for (int i = 0; i < 3; i++) {
+    auto err = amber.stream_sensor(response, "sensor-1", data, 3);
+    ASSERT_NE(err, nullptr);
+    EXPECT_EQ(err->code, 400);
+    EXPECT_EQ(err->message, "sensor not configured");
+    delete err;
+    EXPECT_EQ(take_formats(),
+              i == 0 ? std::vector<std::string>({"packed", "csv"})
+                     : std::vector<std::string>({"csv"}));
+  }
+}
+
+TEST_F(StreamFormatTest, HandleFollowsClientSettings) {
+  accept_packed = true;
+  accept_csv = true; // a gzipped body does not show its format
+  amber_sdk amber("", "");
+  amber.set_response_compression(false);
+  auto handle = amber.prepare_sensor("sensor-1");
+  std::vector<float> data(4000, 1.5f);
+  stream_sensor_response response;
+
+  // settings changed after the handle was prepared reach its requests, and
+  // the encoding announced is the one the compressor applied
+  amber.set_response_compression(true);
+  amber.set_compression(compression_codec::gzip, compression_level_default,
+                        1000);
+  ASSERT_EQ(handle->stream_sensor(response, data.data(), data.size()),
+            nullptr);
+  EXPECT_EQ(last_headers["content-encoding"], "gzip");
+  EXPECT_EQ(last_headers.count("accept-encoding"), 1u);
+
+  amber.set_compression(compression_codec::none);
+  ASSERT_EQ(handle->stream_sensor(response, data.data(), data.size()),
+            nullptr);
+  EXPECT_EQ(last_headers.count("content-encoding"), 0u);
+  EXPECT_EQ(last_headers["sensorid"], "sensor-1");
+}
+
+TEST_F(StreamFormatTest, ThrowingCallbackLeavesEngineRunning) {
+  accept_csv = true;
+  amber_sdk amber("", "");
+  amber.stream_sensor_async(
+      "sensor-1", "1,2,3", false,
+      [](error_response *err, stream_sensor_response &) {
+        delete err;
+        throw std::runtime_error("callback failed");
+      });
+
+  // later requests on the same engine still complete
+  auto result = amber.stream_sensor_async("sensor-1", "1,2,3", false).get();
+  EXPECT_EQ(result.err, nullptr);
+  EXPECT_EQ(result.response.state, "Monitoring");
+}
+
+} // namespace